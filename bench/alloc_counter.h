@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+
+// Number of operator new calls in the process so far. The replaced
+// operators live in alloc_counter.cpp, out of line, so the compiler does
+// not pair an inlined malloc with a delete.
+uint64_t allocationCount();
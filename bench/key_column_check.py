@@ -0,0 +1,100 @@
+"""
+Check that the tools which hash raw lines see 7-column keys with commas as
+parseRecord does: the key's pieces glued together without the commas.
+
+Writes a small 7col trace in which every key appears once plainly and once
+with a comma inside ("k12" and "k,12"), then checks that
+`sampling -m shards` keeps or drops both rows of a key together, that
+`shards-fixed-size` counts distinct keys by the glued key, and that
+`split_trace -p` puts both rows of a key in one part and spreads the keys.
+
+    python3 bench/key_column_check.py --bin-dir build
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+KEYS = 2000
+
+
+def tool_path(bin_dir, tool):
+    return os.path.join(bin_dir, tool + ".out")
+
+
+def run(command, work_dir):
+    result = subprocess.run(command, cwd=work_dir, stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE, text=True,
+                            env=dict(os.environ, TRACE_PROGRESS="0"))
+    if result.returncode != 0:
+        sys.exit("{} failed with {}:\n{}".format(" ".join(command), result.returncode,
+                                                result.stderr))
+
+
+def write_trace(path):
+    with open(path, "w") as f:
+        for i in range(KEYS):
+            f.write("{},k{},{},100,1,get,0\n".format(2 * i, i, len(str(i)) + 1))
+            f.write("{},k,{},{},100,1,get,0\n".format(2 * i + 1, i, len(str(i)) + 1))
+
+
+def glued_keys(path):
+    """{glued key: rows} of a 7col file."""
+    keys = {}
+    with open(path) as f:
+        for line in f:
+            fields = line.rstrip("\n").split(",")
+            key = "".join(fields[1:-5])
+            keys[key] = keys.get(key, 0) + 1
+    return keys
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--bin-dir", required=True)
+    args = parser.parse_args()
+    args.bin_dir = os.path.abspath(args.bin_dir)
+
+    failures = []
+    with tempfile.TemporaryDirectory() as work_dir:
+        write_trace(os.path.join(work_dir, "trace.csv"))
+        sampling = tool_path(args.bin_dir, "sampling")
+
+        run([sampling, "-m", "shards", "-f", "7col", "trace.csv", "shards.csv", "4"], work_dir)
+        kept = glued_keys(os.path.join(work_dir, "shards.csv"))
+        split = [key for key, rows in kept.items() if rows != 2]
+        if not kept or split:
+            failures.append("shards: {} keys sampled, {} with one row of two".format(
+                len(kept), len(split)))
+
+        max_keys = KEYS // 4
+        run([sampling, "-m", "shards-fixed-size", "--max-keys", str(max_keys), "-f", "7col",
+             "trace.csv", "fixed.csv", "1"], work_dir)
+        kept = glued_keys(os.path.join(work_dir, "fixed.csv"))
+        if not kept or len(kept) > max_keys:
+            failures.append("shards-fixed-size: {} keys kept, budget {}".format(
+                len(kept), max_keys))
+
+        parts = 4
+        run([tool_path(args.bin_dir, "split_trace"), "-i", "trace.csv", "-o", "split", "-p",
+             str(parts), "-f", "7col"], work_dir)
+        owner = {}
+        for p in range(parts):
+            for key in glued_keys(os.path.join(work_dir, "split_part{}.csv".format(p))):
+                owner.setdefault(key, set()).add(p)
+        shared = [key for key, owners in owner.items() if len(owners) > 1]
+        used = set().union(*owner.values()) if owner else set()
+        if len(owner) != KEYS or shared or len(used) != parts:
+            failures.append("split_trace -p: {} keys, {} in several parts, {} parts used".format(
+                len(owner), len(shared), len(used)))
+
+    for failure in failures:
+        print(failure)
+    print("ok" if not failures else "FAIL")
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,99 @@
+"""
+Accuracy check of miss_ratio_curve's sampled curves.
+
+Generates a trace with generate_trace, runs miss_ratio_curve exactly (-n 1)
+and sampled (-n 10 by default), and compares the sampled miss and byte
+miss ratios with the exact ones at every sampled cache size. Exits with 1
+when the mean absolute error of a curve exceeds the tolerance.
+
+The default Zipf skew of 0.99 is the one generate_trace and the Twitter
+traces have. Under it the hot keys hold most of the bytes, so this checks
+that miss_ratio_curve tracks them exactly (--exact-keys) instead of leaving
+them to the sample.
+
+    python3 bench/mrc_sampling_check.py --bin-dir build
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+
+def tool_path(bin_dir, tool):
+    return os.path.join(bin_dir, tool + ".out")
+
+
+def run(command):
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True,
+                            env=dict(os.environ, TRACE_PROGRESS="0"))
+    if result.returncode != 0:
+        sys.exit("{} failed with {}:\n{}".format(" ".join(command), result.returncode,
+                                                result.stderr))
+    return result.stdout
+
+
+def parse_curves(output):
+    """{title: [(cache_size, miss_ratio, byte_miss_ratio)]} of one run."""
+    curves = {}
+    points = None
+    for line in output.splitlines():
+        if line.startswith("=== "):
+            points = curves.setdefault(line.strip("= "), [])
+        elif line and not line.startswith("#") and points is not None:
+            size, miss, byte_miss = line.split()
+            points.append((int(size), float(miss), float(byte_miss)))
+    return curves
+
+
+def exact_at(points, size):
+    """Exact ratios of the largest exact cache size at or below `size`."""
+    miss, byte_miss = 1.0, 1.0
+    for cache_size, m, b in points:
+        if cache_size > size:
+            break
+        miss, byte_miss = m, b
+    return miss, byte_miss
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--bin-dir", required=True)
+    parser.add_argument("--rows", type=int, default=2000000)
+    parser.add_argument("--keys", type=int, default=500000)
+    parser.add_argument("--alpha", type=float, default=0.99)
+    parser.add_argument("--ratio", type=int, default=10)
+    parser.add_argument("--tolerance", type=float, default=0.03,
+                        help="Largest mean absolute error of a sampled curve")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as work_dir:
+        trace = os.path.join(work_dir, "trace.csv")
+        run([tool_path(args.bin_dir, "generate_trace"), "-n", str(args.rows), "-k",
+             str(args.keys), "-a", str(args.alpha), "-s", "1", "-f", "5col", trace])
+        mrc = tool_path(args.bin_dir, "miss_ratio_curve")
+        exact = parse_curves(run([mrc, "-n", "1", trace]))
+        sampled = parse_curves(run([mrc, "-n", str(args.ratio), trace]))
+
+    failed = False
+    for title, points in sorted(sampled.items()):
+        if not points or not exact.get(title):
+            continue
+        miss_error = 0.0
+        byte_error = 0.0
+        for size, miss, byte_miss in points:
+            exact_miss, exact_byte_miss = exact_at(exact[title], size)
+            miss_error += abs(miss - exact_miss)
+            byte_error += abs(byte_miss - exact_byte_miss)
+        miss_error /= len(points)
+        byte_error /= len(points)
+        ok = miss_error <= args.tolerance and byte_error <= args.tolerance
+        failed |= not ok
+        print("{:<28} miss {:.4f} byte_miss {:.4f} {}".format(
+            title, miss_error, byte_error, "ok" if ok else "FAIL"))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,234 @@
+"""
+Throughput regression check for the tools.
+
+Generates fixed inputs with generate_trace, runs every tool on them with
+TRACE_REPORT set, and compares rows/s, wall time and peak RSS against a
+baseline file. Exits with 1 when any metric is worse than the baseline by
+more than the threshold.
+
+    python3 bench/perf_regression.py --bin-dir build --baseline perf_baseline.json
+    python3 bench/perf_regression.py --bin-dir build --baseline perf_baseline.json --update
+
+Without a baseline file the first run records one. --ratchet moves the
+baseline to every metric that improved beyond the threshold, so a speedup,
+once won, is what later runs are held to.
+"""
+
+import argparse
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+
+
+def case_list(rows):
+    """(name, tool, arguments, input rows) of every measured run."""
+    half = rows // 2
+    return [
+        ("preprocess_trace", "preprocess_trace", ["raw.csv", "out/preprocessed.csv"], rows),
+        ("merge_traces", "merge_traces",
+         ["out/merged.csv", "2", "raw_a.csv", "raw_b.csv"], 2 * half),
+        ("sampling_random", "sampling", ["trace.csv", "out/s10.csv", "10"], rows),
+        ("sampling_shards", "sampling",
+         ["-m", "shards", "trace.csv", "out/shards10.csv", "10"], rows),
+        ("split_trace_lines", "split_trace",
+         ["-i", "trace.csv", "-o", "out/lines", "-l", str(max(1, rows // 8))], rows),
+        ("split_trace_byte_range", "split_trace",
+         ["-i", "trace.csv", "-o", "out/range", "-l", str(max(1, rows // 8)), "--byte-range"],
+         rows),
+        ("split_trace_partitions", "split_trace",
+         ["-i", "trace.csv", "-o", "out/part", "-p", "8"], rows),
+        ("route_trace", "route_trace",
+         ["-i", "trace.csv", "-r", "size<=2KB", "out/under.csv", "-r", "size>2KB",
+          "out/over.csv"], rows),
+        ("trace_info", "trace_info", ["-o", "out/trace.info", "trace.csv"], rows),
+        ("hash_key", "hash_key", ["trace.csv", "out/hashed.csv"], rows),
+        ("check_hash_conflict", "check_hash_conflict", ["trace.csv"], rows),
+        ("obj_size_bin", "obj_size_bin", ["trace.csv"], rows),
+        ("reuse_distance", "reuse_distance", ["trace.csv"], rows),
+        ("reuse_distance_bytes", "reuse_distance", ["-w", "bytes", "trace.csv"], rows),
+        ("miss_ratio_curve", "miss_ratio_curve", ["-n", "100", "trace.csv"], rows),
+        ("miss_ratio_curve_fixed_size", "miss_ratio_curve",
+         ["-m", "fixed-size", "-n", "1", "--max-keys", "4096", "trace.csv"], rows),
+        ("working_set", "working_set", ["-i", "1s", "raw.csv"], rows),
+        ("time_series", "time_series", ["-i", "1s", "raw.csv"], rows),
+        ("top_keys", "top_keys", ["trace.csv"], rows),
+        ("inter_reference", "inter_reference", ["raw.csv"], rows),
+    ]
+
+
+def tool_path(bin_dir, tool):
+    return os.path.join(bin_dir, tool + ".out")
+
+
+def run(command, work_dir, env=None):
+    result = subprocess.run(command, cwd=work_dir, env=env,
+                            stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    if result.returncode != 0:
+        sys.exit("{} failed with {}:\n{}".format(" ".join(command), result.returncode,
+                                                result.stderr))
+
+
+def generate_inputs(args):
+    """Writes the inputs once per (rows, keys); reruns reuse them."""
+    stamp = os.path.join(args.work_dir, "inputs.json")
+    wanted = {"rows": args.rows, "keys": args.keys}
+    if os.path.exists(stamp):
+        with open(stamp) as f:
+            if json.load(f) == wanted:
+                return
+    generate = tool_path(args.bin_dir, "generate_trace")
+    common = ["-k", str(args.keys), "-t", str(args.threads)]
+    half = str(args.rows // 2)
+    run([generate, "-n", str(args.rows), "-s", "1", "-f", "5col", "trace.csv"] + common,
+        args.work_dir)
+    run([generate, "-n", str(args.rows), "-s", "2", "raw.csv"] + common, args.work_dir)
+    run([generate, "-n", half, "-s", "3", "raw_a.csv"] + common, args.work_dir)
+    run([generate, "-n", half, "-s", "4", "raw_b.csv"] + common, args.work_dir)
+    with open(stamp, "w") as f:
+        json.dump(wanted, f)
+
+
+def measure(args, name, tool, arguments, rows):
+    """Best of --repeat runs: lowest wall time and lowest peak RSS."""
+    out_dir = os.path.join(args.work_dir, "out")
+    report = os.path.join(args.work_dir, "report.json")
+    env = dict(os.environ, TRACE_REPORT=report, TRACE_PROGRESS="0")
+    env.pop("TRACE_PERF", None)
+    best = None
+    for _ in range(args.repeat):
+        shutil.rmtree(out_dir, ignore_errors=True)
+        os.makedirs(out_dir)
+        run([tool_path(args.bin_dir, tool)] + arguments, args.work_dir, env)
+        with open(report) as f:
+            data = json.load(f)
+        wall = data["wall_seconds"]
+        rss = data["max_rss_kb"]
+        if best is None:
+            best = {"wall_seconds": wall, "max_rss_kb": rss}
+        else:
+            best["wall_seconds"] = min(best["wall_seconds"], wall)
+            best["max_rss_kb"] = min(best["max_rss_kb"], rss)
+    best["rows_per_second"] = rows / best["wall_seconds"] if best["wall_seconds"] > 0 else 0
+    return best
+
+
+# metric -> True when larger is better
+METRICS = {"rows_per_second": True, "wall_seconds": False, "max_rss_kb": False}
+
+
+def compare(name, current, base, args):
+    """Returns (metric, "regressed" or "improved", description) per changed metric."""
+    changes = []
+    for metric, larger_is_better in METRICS.items():
+        if metric not in base or base[metric] == 0:
+            continue
+        threshold = args.rss_threshold if metric == "max_rss_kb" else args.threshold
+        change = current[metric] / base[metric] - 1
+        worse = -change if larger_is_better else change
+        text = "{} {}: {:.4g} -> {:.4g} ({:+.1f}%)".format(name, metric, base[metric],
+                                                        current[metric], 100 * change)
+        if worse > threshold:
+            changes.append((metric, "regressed", text))
+        elif -worse > threshold:
+            changes.append((metric, "improved", text))
+    return changes
+
+
+def machine():
+    cpu = platform.processor()
+    try:
+        with open("/proc/cpuinfo") as f:
+            for line in f:
+                if line.startswith("model name"):
+                    cpu = line.split(":", 1)[1].strip()
+                    break
+    except OSError:
+        pass
+    return {"host": platform.node(), "cpu": cpu, "cpus": os.cpu_count()}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--bin-dir", required=True, help="Build directory with the *.out tools")
+    parser.add_argument("--baseline", required=True, help="Baseline JSON file")
+    parser.add_argument("--work-dir", default="perf-run", help="Inputs and outputs go here")
+    parser.add_argument("--rows", type=int, default=2000000, help="Requests per input")
+    parser.add_argument("--keys", type=int, default=200000, help="Distinct keys per input")
+    parser.add_argument("--threads", type=int, default=os.cpu_count(),
+                        help="Threads for generate_trace (tools use their defaults)")
+    parser.add_argument("--repeat", type=int, default=3, help="Runs per tool; the best counts")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="Allowed relative slowdown of rows/s and wall time")
+    parser.add_argument("--rss-threshold", type=float, default=0.10,
+                        help="Allowed relative growth of peak RSS")
+    parser.add_argument("--filter", default="", help="Only cases whose name contains this")
+    parser.add_argument("--update", action="store_true",
+                        help="Overwrite the baseline with this run")
+    parser.add_argument("--ratchet", action="store_true",
+                        help="Adopt every metric that improved beyond the threshold")
+    args = parser.parse_args()
+    args.bin_dir = os.path.abspath(args.bin_dir)
+    args.work_dir = os.path.abspath(args.work_dir)
+    os.makedirs(args.work_dir, exist_ok=True)
+
+    generate_inputs(args)
+    results = {}
+    for name, tool, arguments, rows in case_list(args.rows):
+        if args.filter in name:
+            results[name] = measure(args, name, tool, arguments, rows)
+            r = results[name]
+            print("{:<24} {:>10.3f} Mrows/s {:>9.3f} s {:>9.1f} MB".format(
+                name, r["rows_per_second"] / 1e6, r["wall_seconds"], r["max_rss_kb"] / 1024))
+
+    current = {"machine": machine(), "rows": args.rows, "keys": args.keys, "cases": results}
+    baseline = None
+    if os.path.exists(args.baseline) and not args.update:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    if baseline is None:
+        with open(args.baseline, "w") as f:
+            json.dump(current, f, indent=2, sort_keys=True)
+        print("Recorded baseline {}".format(args.baseline))
+        return 0
+
+    if (baseline.get("rows"), baseline.get("keys")) != (args.rows, args.keys):
+        sys.exit("Baseline was recorded with --rows {} --keys {}; rerun with those or --update"
+                 .format(baseline.get("rows"), baseline.get("keys")))
+    if baseline.get("machine") != current["machine"]:
+        print("Warning: baseline was recorded on {}".format(baseline.get("machine")))
+
+    regressions, improvements = [], []
+    changed = False
+    for name, result in results.items():
+        base = baseline["cases"].get(name)
+        if base is None:
+            baseline["cases"][name] = result
+            changed = True
+            continue
+        for metric, status, text in compare(name, result, base, args):
+            if status == "regressed":
+                regressions.append(text)
+                continue
+            improvements.append(text)
+            if args.ratchet:
+                base[metric] = result[metric]
+                changed = True
+
+    for text in improvements:
+        print("improved:  " + text)
+    for text in regressions:
+        print("REGRESSED: " + text)
+    if changed:
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=2, sort_keys=True)
+    if improvements and not args.ratchet:
+        print("Rerun with --ratchet to hold later runs to the improvements.")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,303 @@
+// Microbenchmarks for the per-row hot paths of the tools: line parsers, key
+// hashes, the per-key maps and the output writers. Every benchmark runs on
+// the same generated trace (fixed row count, key count and Zipf skew), so
+// numbers are comparable across commits and machines.
+#include "include/argparse/argparse.hpp"
+#include "include/fmt/core.h"
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "csv.h"
+#include "bench/alloc_counter.h"
+#include "common/buffered_writer.h"
+#include "common/key_hash.h"
+#include "common/line_scan.h"
+#include "common/md5_truncate.h"
+#include "common/raw_trace.h"
+#include "common/trace_record.h"
+#include "common/trace_generator.h"
+#include "common/trace_stats.h"
+
+// ----------------------------------------------------------------
+// Input generation
+// ----------------------------------------------------------------
+struct Corpus {
+  std::string raw;     // 7 columns, no header
+  std::string fiveCol; // key,op,size,op_count,key_size with header
+  std::vector<std::string> keys;       // key of every row
+  std::vector<uint32_t> objectSizes;   // object size of every row
+  std::vector<trace::RawRow> rawRows;  // parsed raw rows, for the writers
+};
+
+Corpus generateCorpus(uint64_t rows, uint64_t numKeys, double alpha, uint64_t seed) {
+  trace::GeneratorConfig config;
+  trace::setGeneratorDefaults(config);
+  config.rows = rows;
+  config.keys = numKeys;
+  config.alpha = alpha;
+  config.seed = seed;
+  trace::TraceGenerator generator(config);
+
+  Corpus corpus;
+  corpus.fiveCol = trace::fiveColumnHeader();
+  corpus.keys.reserve(rows);
+  corpus.objectSizes.reserve(rows);
+  corpus.rawRows.reserve(rows);
+  trace::GeneratedRow row;
+  for (uint64_t i = 0; i < rows; ++i) {
+    generator.appendRow(i, trace::TraceFormat::SevenColumn, row, corpus.raw);
+    generator.appendRow(i, trace::TraceFormat::FiveColumn, row, corpus.fiveCol);
+    corpus.keys.push_back(row.key);
+    corpus.objectSizes.push_back(row.keySize + row.valueSize);
+    corpus.rawRows.push_back({row.timestamp, row.key, row.keySize, row.valueSize,
+                              row.clientId, *row.op, row.ttl});
+  }
+  return corpus;
+}
+
+// ----------------------------------------------------------------
+// Benchmarks
+// ----------------------------------------------------------------
+struct Work {
+  uint64_t rows = 0;
+  uint64_t bytes = 0;
+  uint64_t checksum = 0;  // keeps the optimizer from dropping the work
+};
+
+struct Benchmark {
+  std::string name;
+  std::function<Work()> run;
+};
+
+uint64_t keyBytes(const Corpus &corpus) {
+  uint64_t bytes = 0;
+  for (const auto &key : corpus.keys) {
+    bytes += key.size();
+  }
+  return bytes;
+}
+
+std::vector<Benchmark> makeBenchmarks(const Corpus &corpus, const std::string &scratch) {
+  std::vector<Benchmark> benchmarks;
+
+  // --- parsers -------------------------------------------------
+  benchmarks.push_back({"parse/raw_istringstream", [&]() {
+    // preprocess_trace: one std::string per line, split with getline.
+    Work work;
+    trace::RawRow row;
+    trace::forEachLine(corpus.raw, [&](std::string_view view) {
+      std::string line(view);
+      work.rows++;
+      work.checksum += trace::parseRawLine(line, row) ? row.value_size : 0;
+    });
+    work.bytes = corpus.raw.size();
+    return work;
+  }});
+  benchmarks.push_back({"parse/record_7col", [&]() {
+    Work work;
+    trace::TraceRecord rec;
+    trace::forEachLine(corpus.raw, [&](std::string_view line) {
+      work.rows++;
+      work.checksum += trace::parseRecord(line, trace::TraceFormat::SevenColumn, rec)
+                           ? rec.valueSize : 0;
+    });
+    work.bytes = corpus.raw.size();
+    return work;
+  }});
+  benchmarks.push_back({"parse/csv_reader_5col", [&]() {
+    // trace_info and check_hash_conflict.
+    Work work;
+    io::CSVReader<5> in("bench", corpus.fiveCol.data(),
+                        corpus.fiveCol.data() + corpus.fiveCol.size());
+    in.read_header(io::ignore_extra_column, "key", "op", "size", "op_count", "key_size");
+    std::string key, op;
+    uint32_t size = 0, opCount = 0, keySize = 0;
+    while (in.read_row(key, op, size, opCount, keySize)) {
+      work.rows++;
+      work.checksum += size;
+    }
+    work.bytes = corpus.fiveCol.size();
+    return work;
+  }});
+  benchmarks.push_back({"parse/record_5col", [&]() {
+    Work work;
+    trace::TraceRecord rec;
+    std::string_view body(corpus.fiveCol);
+    body = body.substr(trace::nextLineStart(body, 0));
+    trace::forEachLine(body, [&](std::string_view line) {
+      work.rows++;
+      work.checksum += trace::parseRecord(line, trace::TraceFormat::FiveColumn, rec)
+                           ? rec.objectSize : 0;
+    });
+    work.bytes = corpus.fiveCol.size();
+    return work;
+  }});
+
+  // --- key hashes ----------------------------------------------
+  benchmarks.push_back({"hash/md5_truncate", [&]() {
+    Work work;
+    for (const auto &key : corpus.keys) {
+      work.checksum += trace::md5Truncate(key).back();
+    }
+    work.rows = corpus.keys.size();
+    work.bytes = keyBytes(corpus);
+    return work;
+  }});
+  benchmarks.push_back({"hash/hash_key", [&]() {
+    Work work;
+    for (const auto &key : corpus.keys) {
+      work.checksum += trace::hashKey(key);
+    }
+    work.rows = corpus.keys.size();
+    work.bytes = keyBytes(corpus);
+    return work;
+  }});
+
+  // --- per-key maps --------------------------------------------
+  benchmarks.push_back({"map/trace_stats", [&]() {
+    // trace_info's string-keyed robin_hood map.
+    Work work;
+    trace::StatsAccumulator acc;
+    for (size_t i = 0; i < corpus.keys.size(); ++i) {
+      uint32_t objectSize = corpus.objectSizes[i];
+      uint32_t keySize = static_cast<uint32_t>(corpus.keys[i].size());
+      trace::updateStats(acc, corpus.keys[i], keySize, objectSize - keySize, objectSize);
+    }
+    work.rows = corpus.keys.size();
+    work.bytes = keyBytes(corpus);
+    work.checksum = acc.mapKeyAgg.size();
+    return work;
+  }});
+  benchmarks.push_back({"map/key_hash_flat", [&]() {
+    // obj_size_bin's 64-bit key hash -> size table.
+    Work work;
+    robin_hood::unordered_flat_map<uint64_t, uint32_t> sizes;
+    for (size_t i = 0; i < corpus.keys.size(); ++i) {
+      sizes[trace::hashKey(corpus.keys[i])] = corpus.objectSizes[i];
+    }
+    work.rows = corpus.keys.size();
+    work.bytes = keyBytes(corpus);
+    work.checksum = sizes.size();
+    return work;
+  }});
+
+  // --- writers -------------------------------------------------
+  benchmarks.push_back({"write/ofstream_raw_row", [&, scratch]() {
+    // preprocess_trace: fields formatted through operator<<.
+    Work work;
+    std::ofstream out(scratch);
+    for (const auto &row : corpus.rawRows) {
+      trace::writeRawRow(out, row);
+    }
+    work.rows = corpus.rawRows.size();
+    work.bytes = corpus.raw.size();
+    return work;
+  }});
+  benchmarks.push_back({"write/ofstream_lines", [&, scratch]() {
+    // merge_traces and split_trace: whole lines through an ofstream.
+    Work work;
+    std::ofstream out(scratch);
+    trace::forEachLine(corpus.raw, [&](std::string_view line) {
+      out << line << '\n';
+      work.rows++;
+    });
+    work.bytes = corpus.raw.size();
+    return work;
+  }});
+  benchmarks.push_back({"write/buffered_writer_lines", [&, scratch]() {
+    Work work;
+    trace::BufferedWriter out;
+    out.open(scratch);
+    trace::forEachLine(corpus.raw, [&](std::string_view line) {
+      out.appendLine(line);
+      work.rows++;
+    });
+    work.bytes = corpus.raw.size();
+    return work;
+  }});
+
+  return benchmarks;
+}
+
+int main(int argc, char **argv) {
+  argparse::ArgumentParser options("trace_bench");
+
+  options.add_argument("--rows")
+      .default_value(uint64_t{1000000})
+      .scan<'u', uint64_t>()
+      .help("Rows in the generated trace");
+  options.add_argument("--keys")
+      .default_value(uint64_t{100000})
+      .scan<'u', uint64_t>()
+      .help("Distinct keys in the generated trace");
+  options.add_argument("--alpha")
+      .default_value(0.99)
+      .scan<'g', double>()
+      .help("Zipf skew of key popularity");
+  options.add_argument("--seed")
+      .default_value(uint64_t{1})
+      .scan<'u', uint64_t>()
+      .help("Generator seed");
+  options.add_argument("--repeat")
+      .default_value(3u)
+      .scan<'u', unsigned>()
+      .help("Runs per benchmark; the fastest is reported");
+  options.add_argument("--filter")
+      .default_value(std::string(""))
+      .help("Only run benchmarks whose name contains this text");
+  options.add_argument("--scratch")
+      .default_value(std::string("/dev/null"))
+      .help("File the writer benchmarks write to");
+
+  try {
+    options.parse_args(argc, argv);
+  } catch (const std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << options;
+    return 1;
+  }
+
+  uint64_t rows = options.get<uint64_t>("--rows");
+  uint64_t keys = options.get<uint64_t>("--keys");
+  double alpha = options.get<double>("--alpha");
+  unsigned repeat = std::max(1u, options.get<unsigned>("--repeat"));
+  auto filter = options.get<std::string>("--filter");
+
+  Corpus corpus = generateCorpus(rows, keys, alpha, options.get<uint64_t>("--seed"));
+  std::cout << fmt::format("# rows={} keys={} alpha={} raw={:.1f}MB 5col={:.1f}MB\n", rows,
+                           keys, alpha, corpus.raw.size() / 1e6,
+                           corpus.fiveCol.size() / 1e6);
+  std::cout << fmt::format("{:<30} {:>10} {:>10} {:>10} {:>12}\n", "benchmark",
+                           "Mrows/s", "MB/s", "ns/row", "allocs/row");
+
+  uint64_t checksum = 0;
+  for (const auto &bench : makeBenchmarks(corpus, options.get<std::string>("--scratch"))) {
+    if (bench.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    double best = 0;
+    Work work;
+    uint64_t allocations = 0;
+    for (unsigned r = 0; r < repeat; ++r) {
+      uint64_t allocsBefore = allocationCount();
+      auto start = std::chrono::steady_clock::now();
+      work = bench.run();
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      allocations = allocationCount() - allocsBefore;
+      if (r == 0 || elapsed.count() < best) {
+        best = elapsed.count();
+      }
+      checksum += work.checksum;
+    }
+    double perRow = work.rows == 0 ? 0 : 1.0 / work.rows;
+    std::cout << fmt::format("{:<30} {:>10.2f} {:>10.1f} {:>10.1f} {:>12.3f}\n", bench.name,
+                             work.rows / best / 1e6, work.bytes / best / 1e6,
+                             best * 1e9 * perRow, allocations * perRow);
+  }
+  std::cout << fmt::format("# checksum {:x}\n", checksum);
+  return 0;
+}
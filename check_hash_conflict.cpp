@@ -1,27 +1,20 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <unordered_map>
-#include <unordered_set>
 #include <fstream>
 #include <sstream>
 
 #include "robin_hood.h"
 #include "csv.h"
-#include "md5.h"   
+#include "common/csv_source.h"
+#include "common/md5_truncate.h"
+#include "common/progress.h"
+#include "common/run_report.h"
 
 
-std::string md5Truncate(const std::string &input, size_t length) {
-    Chocobo1::MD5 md5;
-    md5.addData(input.data(), input.size()).finalize();
-    std::string hashHex = md5.toString();
-    
-    return hashHex.substr(0, length);
-
-}
-
 int main(int argc, char* argv[])
 {
+    trace::RunReport report("check_hash_conflict", argc, argv);
     if (argc < 2) {
         std::cerr << "[Usage] " << argv[0] << " <input_csv_file>\n";
         return 1;
@@ -29,29 +22,44 @@ int main(int argc, char* argv[])
 
     const std::string inputCsvFile = argv[1];
     
-    std::unordered_set<std::string> uniqueKeys;
+    robin_hood::unordered_set<std::string> uniqueKeys;
+    trace::ProgressReporter progress("check_hash_conflict", trace::fileBytes({inputCsvFile}));
+    int uniqueKeysMap = progress.addMap("unique keys");
+    int hashMapMap = progress.addMap("hashed keys");
     
     try {
-        io::CSVReader<5> in(inputCsvFile);
+        trace::ProgressReporter::Batch counted(progress);
+        io::CSVReader<5> in(inputCsvFile, trace::countedFile(inputCsvFile, progress));
         in.read_header(io::ignore_extra_column,
                        "key", "op", "size", "op_count", "key_size");
-        size_t lineCount = 0; 
         std::string key, op;
         int size, op_count, key_size;
         
-        while (in.read_row(key, op, size, op_count, key_size)) {
-            lineCount++;
-	    if(lineCount % 10000000 == 0) {
-	       std::cout << "Processed " << lineCount << " lines so far...\n";
-	    }
+        trace::StageTimer parse(trace::Stage::Parse);
+        trace::StageTimer aggregate(trace::Stage::Aggregate);
+        while (true) {
+            {
+                auto timed = parse.timeCall();
+                if (!in.read_row(key, op, size, op_count, key_size)) {
+                    break;
+                }
+            }
+            parse.count(1, 0);
+            counted.add(1, 0);
+	    auto timed = aggregate.time(key.size());
 	    uniqueKeys.insert(key);
+	    if (uniqueKeys.size() % (1 << 18) == 0) {
+	        progress.publishMap(uniqueKeysMap, trace::mapHealth(uniqueKeys));
+	    }
         }
+        progress.publishMap(uniqueKeysMap, trace::mapHealth(uniqueKeys));
     } catch (const io::error::base& e) {
         std::cerr << "CSV parsing error: " << e.what() << "\n";
         return 1;
     }
     
     std::vector<size_t> testLengths = {16, 17, 18};
+    trace::StageTimer hash(trace::Stage::Hash);
 
     for (auto len : testLengths) {
         std::cout << "\n[ Checking MD5 hash collision for length = " << len << " ]\n";
@@ -61,7 +69,8 @@ int main(int argc, char* argv[])
         bool conflictFound = false;
 
         for (const auto &origKey : uniqueKeys) {
-            std::string hashedKey = md5Truncate(origKey, len);
+            auto timed = hash.time(origKey.size());
+            std::string hashedKey = trace::md5Truncate(origKey, len);
             
             auto it = hashMap.find(hashedKey);
             if (it != hashMap.end()) {
@@ -71,6 +80,9 @@ int main(int argc, char* argv[])
                           << "\n - New Original Key:      " << origKey << "\n\n";
             } else {
                 hashMap[hashedKey] = origKey;
+                if (hashMap.size() % (1 << 18) == 0) {
+                    progress.publishMap(hashMapMap, trace::mapHealth(hashMap));
+                }
             }
         }
 
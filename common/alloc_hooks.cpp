@@ -0,0 +1,45 @@
+// Replaces the global operator new and delete so memory_stats.h can report
+// allocation counts and live heap bytes. Linked into the tools only; the
+// benchmarks count allocations their own way.
+
+#include <malloc.h>
+
+#include <cstdlib>
+#include <new>
+
+#include "common/memory_stats.h"
+
+namespace {
+
+void *allocate(size_t size) noexcept {
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p != nullptr) {
+    trace::countAllocation(malloc_usable_size(p));
+  }
+  return p;
+}
+
+void release(void *p) noexcept {
+  if (p != nullptr) {
+    trace::countFree(malloc_usable_size(p));
+    std::free(p);
+  }
+}
+
+}  // namespace
+
+void *operator new(size_t size) {
+  if (void *p = allocate(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void operator delete(void *p) noexcept { release(p); }
+void operator delete[](void *p) noexcept { release(p); }
+void operator delete(void *p, size_t) noexcept { release(p); }
+void operator delete[](void *p, size_t) noexcept { release(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { release(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { release(p); }
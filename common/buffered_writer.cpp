@@ -0,0 +1,51 @@
+#include "common/buffered_writer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace trace {
+
+bool BufferedWriter::open(const std::string &path) {
+  close();
+  path_ = path;
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    std::cerr << "Cannot open " << path << ": " << std::strerror(errno)
+              << "\n";
+    return false;
+  }
+  buffer_.reserve(capacity_);
+  return true;
+}
+
+void BufferedWriter::flush() {
+  size_t done = 0;
+  while (fd_ >= 0 && done < buffer_.size()) {
+    ssize_t put = ::write(fd_, buffer_.data() + done, buffer_.size() - done);
+    if (put < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "Write to " << path_ << " failed: "
+                << std::strerror(errno) << "\n";
+      break;
+    }
+    done += put;
+  }
+  bytesWritten_ += done;
+  buffer_.clear();
+}
+
+void BufferedWriter::close() {
+  if (fd_ >= 0) {
+    flush();
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+}  // namespace trace
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace trace {
+
+// Append-only file writer with its own large buffer. Many of these can be
+// open at once (one per output of a router or partitioner) without every
+// row going through an ofstream and its locale machinery.
+class BufferedWriter {
+ public:
+  explicit BufferedWriter(size_t capacity = 1 << 20) : capacity_(capacity) {}
+  BufferedWriter(const BufferedWriter &) = delete;
+  BufferedWriter &operator=(const BufferedWriter &) = delete;
+  BufferedWriter(BufferedWriter &&other) noexcept
+      : fd_(other.fd_),
+        capacity_(other.capacity_),
+        buffer_(std::move(other.buffer_)),
+        path_(std::move(other.path_)),
+        bytesWritten_(other.bytesWritten_) {
+    other.fd_ = -1;
+  }
+  ~BufferedWriter() { close(); }
+
+  // Prints the reason to std::cerr and returns false on failure.
+  bool open(const std::string &path);
+
+  void append(std::string_view data) {
+    if (buffer_.size() + data.size() > capacity_) {
+      flush();
+    }
+    buffer_.append(data.data(), data.size());
+  }
+
+  // Appends `line` followed by '\n' unless it already ends with one.
+  void appendLine(std::string_view line) {
+    append(line);
+    if (line.empty() || line.back() != '\n') {
+      append("\n");
+    }
+  }
+
+  void flush();
+  void close();
+
+  bool isOpen() const { return fd_ >= 0; }
+  const std::string &path() const { return path_; }
+  uint64_t bytesWritten() const { return bytesWritten_ + buffer_.size(); }
+
+ private:
+  int fd_ = -1;
+  size_t capacity_;
+  std::string buffer_;
+  std::string path_;
+  uint64_t bytesWritten_ = 0;
+};
+
+}  // namespace trace
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "include/csv/csv.h"
+#include "common/progress.h"
+
+namespace trace {
+
+// csv.h byte source over a file that adds every block it reads to
+// `progress`, so CSVReader loops report bytes without per-row work:
+//
+//   io::CSVReader<5> in(path, trace::countedFile(path, progress));
+class CountedFileSource : public io::ByteSourceBase {
+ public:
+  CountedFileSource(FILE *file, ProgressReporter &progress)
+      : file_(file), progress_(progress) {
+    std::setvbuf(file_, nullptr, _IONBF, 0);  // CSVReader buffers itself
+  }
+  ~CountedFileSource() override { std::fclose(file_); }
+
+  int read(char *buffer, int size) override {
+    int got = static_cast<int>(std::fread(buffer, 1, size, file_));
+    progress_.add(0, got);
+    return got;
+  }
+
+ private:
+  FILE *file_;
+  ProgressReporter &progress_;
+};
+
+// Opens `path` like CSVReader does, throwing io::error::can_not_open_file.
+inline std::unique_ptr<io::ByteSourceBase> countedFile(const std::string &path,
+                                                       ProgressReporter &progress) {
+  FILE *file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    io::error::can_not_open_file err;
+    err.set_errno(errno);
+    err.set_file_name(path.c_str());
+    throw err;
+  }
+  return std::make_unique<CountedFileSource>(file, progress);
+}
+
+}  // namespace trace
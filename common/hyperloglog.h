@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace trace {
+
+// HyperLogLog distinct counter over 64-bit hashes (e.g. hashKey, mixHash).
+//
+// 2^p one-byte registers; the relative standard error is about
+// 1.04 / sqrt(2^p), 1.6% at the default p = 12 (4 KB). Small counts use
+// linear counting, so they are close to exact. Counters of the same
+// precision merge by taking the register maxima.
+class HyperLogLog {
+ public:
+  explicit HyperLogLog(unsigned precision = 12)
+      : bits_(precision), registers_(size_t{1} << precision, 0) {}
+
+  void add(uint64_t hash) {
+    size_t index = hash >> (64 - bits_);
+    // Rank of the first 1 bit after the index bits; the OR bounds it when
+    // they are all 0.
+    uint64_t rest = (hash << bits_) | (uint64_t{1} << (bits_ - 1));
+    uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+    registers_[index] = std::max(registers_[index], rank);
+  }
+
+  void merge(const HyperLogLog &other) {
+    for (size_t i = 0; i < registers_.size(); ++i) {
+      registers_[i] = std::max(registers_[i], other.registers_[i]);
+    }
+  }
+
+  void clear() { std::fill(registers_.begin(), registers_.end(), 0); }
+
+  double estimate() const {
+    double m = static_cast<double>(registers_.size());
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t r : registers_) {
+      sum += std::ldexp(1.0, -r);
+      zeros += r == 0;
+    }
+    double alpha = 0.7213 / (1 + 1.079 / m);
+    double raw = alpha * m * m / sum;
+    if (raw <= 2.5 * m && zeros > 0) {
+      return m * std::log(m / static_cast<double>(zeros));
+    }
+    return raw;
+  }
+
+ private:
+  unsigned bits_;
+  std::vector<uint8_t> registers_;
+};
+
+}  // namespace trace
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "include/robin_hood/robin_hood.h"
+
+namespace trace {
+
+// 64-bit key hash shared by every tool that samples or partitions by key, so
+// the same key always makes the same decision everywhere.
+//
+// robin_hood::hash_bytes leaves out its final avalanche step (the map does it
+// when indexing); it is applied here because callers compare the whole value
+// against a threshold. mixHash is that step on its own, for integer ids.
+inline uint64_t mixHash(uint64_t h) {
+  h ^= h >> 33;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= UINT64_C(0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+  return h;
+}
+
+inline uint64_t hashKey(std::string_view key) {
+  return mixHash(robin_hood::hash_bytes(key.data(), key.size()));
+}
+
+// Largest hash kept when sampling keys at a rate of 1/n.
+inline uint64_t hashLimitForRatio(uint64_t n) { return UINT64_MAX / n; }
+
+// Fraction of the hash space at or below `limit`.
+inline double hashLimitRate(uint64_t limit) {
+  return (static_cast<double>(limit) + 1.0) / 18446744073709551616.0;
+}
+
+}  // namespace trace
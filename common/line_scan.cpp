@@ -0,0 +1,59 @@
+#include "common/line_scan.h"
+
+namespace trace {
+
+uint64_t countNewlines(const char *data, size_t size) {
+  uint64_t count = 0;
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    count += __builtin_popcountll(newlineMask64(data + i));
+  }
+  for (; i < size; ++i) {
+    count += data[i] == '\n';
+  }
+  return count;
+}
+
+size_t findNthNewline(const char *data, size_t size, uint64_t nth) {
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    uint64_t mask = newlineMask64(data + i);
+    uint64_t count = __builtin_popcountll(mask);
+    if (nth < count) {
+      for (uint64_t k = 0; k < nth; ++k) {
+        mask &= mask - 1;
+      }
+      return i + __builtin_ctzll(mask);
+    }
+    nth -= count;
+  }
+  for (; i < size; ++i) {
+    if (data[i] == '\n' && nth-- == 0) {
+      return i;
+    }
+  }
+  return size;
+}
+
+uint64_t countLines(std::string_view text) {
+  uint64_t count = countNewlines(text.data(), text.size());
+  if (!text.empty() && text.back() != '\n') {
+    count++;
+  }
+  return count;
+}
+
+std::vector<size_t> splitAtLines(std::string_view text, size_t parts) {
+  std::vector<size_t> bounds(parts + 1, text.size());
+  bounds[0] = 0;
+  for (size_t i = 1; i < parts; ++i) {
+    size_t target = text.size() / parts * i;
+    bounds[i] = nextLineStart(text, target == 0 ? 0 : target - 1);
+    if (bounds[i] < bounds[i - 1]) {
+      bounds[i] = bounds[i - 1];
+    }
+  }
+  return bounds;
+}
+
+}  // namespace trace
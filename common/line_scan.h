@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace trace {
+
+// Bit i of the result is set when p[i] == '\n', for the 64 bytes at p.
+inline uint64_t newlineMask64(const char *p) {
+#if defined(__AVX2__)
+  const __m256i nl = _mm256_set1_epi8('\n');
+  uint32_t lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)), nl)));
+  uint32_t hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32)), nl)));
+  return (static_cast<uint64_t>(hi) << 32) | lo;
+#elif defined(__SSE2__)
+  const __m128i nl = _mm_set1_epi8('\n');
+  uint64_t mask = 0;
+  for (int i = 0; i < 4; ++i) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+    uint64_t bits = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, nl)));
+    mask |= bits << (16 * i);
+  }
+  return mask;
+#else
+  uint64_t mask = 0;
+  for (int i = 0; i < 64; ++i) {
+    mask |= static_cast<uint64_t>(p[i] == '\n') << i;
+  }
+  return mask;
+#endif
+}
+
+// Number of '\n' bytes in [data, data + size), 64 bytes per step.
+uint64_t countNewlines(const char *data, size_t size);
+
+// Offset of the newline with 0-based index `nth` in [data, data + size), or
+// size if there are not that many.
+size_t findNthNewline(const char *data, size_t size, uint64_t nth);
+
+// Number of lines in `text`, counting a final line without '\n'.
+uint64_t countLines(std::string_view text);
+
+// Offset just past the first '\n' at or after `pos`, or text.size().
+inline size_t nextLineStart(std::string_view text, size_t pos) {
+  if (pos >= text.size()) {
+    return text.size();
+  }
+  const void *nl = std::memchr(text.data() + pos, '\n', text.size() - pos);
+  return nl == nullptr ? text.size()
+                       : static_cast<const char *>(nl) - text.data() + 1;
+}
+
+// Splits `text` into at most `parts` pieces of similar size that all start
+// at a line boundary. Returns parts + 1 offsets (some pieces may be empty).
+std::vector<size_t> splitAtLines(std::string_view text, size_t parts);
+
+// Calls fn(lineWithoutNewline) for every line of `text`.
+template <typename Fn>
+inline void forEachLine(std::string_view text, Fn &&fn) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const void *nl = std::memchr(text.data() + pos, '\n', text.size() - pos);
+    size_t end = nl == nullptr ? text.size()
+                               : static_cast<const char *>(nl) - text.data();
+    fn(text.substr(pos, end - pos));
+    pos = end + 1;
+  }
+}
+
+// Runs fn(i) for i in [0, count) on `count` threads and waits for all.
+template <typename Fn>
+inline void parallelFor(size_t count, Fn &&fn) {
+  if (count == 1) {
+    fn(0);
+    return;
+  }
+  std::vector<std::thread> workers;
+  workers.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    workers.emplace_back([&fn, i]() { fn(i); });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+// Bytes per thread of one window of forEachWindow: enough lines to keep the
+// threads busy, few enough that what they hand over stays small.
+constexpr size_t WINDOW_BYTES = size_t{32} << 20;
+
+// Reads `text` window by window. Each window of about windowBytes per
+// thread is split at lines, parse(t, piece) runs on `threads` threads, one
+// piece each, and then fold() runs on the calling thread, which takes the
+// workers' results in input order (piece t before t + 1). Nothing of the
+// two overlaps, so parse may read what the previous fold left, such as a
+// sampling limit: when a limit only goes down, a stale one keeps too much,
+// never too little.
+template <typename Parse, typename Fold>
+inline void forEachWindow(std::string_view text, size_t threads, size_t windowBytes,
+                          Parse &&parse, Fold &&fold) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = nextLineStart(text, std::min(text.size(), pos + windowBytes * threads));
+    std::string_view window = text.substr(pos, end - pos);
+    pos = end;
+    std::vector<size_t> bounds = splitAtLines(window, threads);
+    parallelFor(threads, [&](size_t t) {
+      parse(t, window.substr(bounds[t], bounds[t + 1] - bounds[t]));
+    });
+    fold();
+  }
+}
+
+}  // namespace trace
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace trace {
+
+// HDR-histogram style counts over the full uint64_t range.
+//
+// Values below 2^(b+1) get one bucket each; above that every power of two
+// is split into 2^b linear sub-buckets, so a bucket is never wider than
+// 2^-b of its lower bound (b = subBucketBits). Binning is one lzcnt, one
+// shift and one add, with no branches.
+class LogLinearHistogram {
+ public:
+  explicit LogLinearHistogram(unsigned subBucketBits = 2)
+      : bits_(subBucketBits),
+        counts_(static_cast<size_t>(65 - subBucketBits) << subBucketBits, 0) {}
+
+  unsigned subBucketBits() const { return bits_; }
+  size_t numBuckets() const { return counts_.size(); }
+
+  size_t indexOf(uint64_t value) const {
+    // OR-ing in 2^b puts every small value in the first linear range.
+    unsigned msb = 63 - __builtin_clzll(value | (uint64_t{1} << bits_));
+    unsigned shift = msb - bits_;
+    return (static_cast<size_t>(shift) << bits_) + (value >> shift);
+  }
+
+  void record(uint64_t value, uint64_t count = 1) {
+    counts_[indexOf(value)] += count;
+    total_ += count;
+  }
+
+  void merge(const LogLinearHistogram &other) {
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+  }
+
+  uint64_t count(size_t index) const { return counts_[index]; }
+  uint64_t total() const { return total_; }
+
+  // Smallest value that falls into bucket `index`.
+  uint64_t lowerBound(size_t index) const {
+    if (index < (size_t{2} << bits_)) {
+      return index;
+    }
+    unsigned shift = static_cast<unsigned>(index >> bits_) - 1;
+    return static_cast<uint64_t>(index - (static_cast<size_t>(shift) << bits_))
+           << shift;
+  }
+
+  // Largest value that falls into bucket `index`.
+  uint64_t upperBound(size_t index) const {
+    return index + 1 < counts_.size() ? lowerBound(index + 1) - 1 : UINT64_MAX;
+  }
+
+  // Upper bound of the bucket holding the q-quantile (0 <= q <= 1), i.e. a
+  // value at most 2^-b above the exact quantile. 0 when empty.
+  uint64_t valueAtQuantile(double q) const {
+    if (total_ == 0) {
+      return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total_ - 1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen > rank) {
+        return upperBound(i);
+      }
+    }
+    return upperBound(counts_.size() - 1);
+  }
+
+  // [first, last] bucket range holding all recorded values; first > last
+  // when empty.
+  size_t firstNonEmpty() const {
+    size_t i = 0;
+    while (i < counts_.size() && counts_[i] == 0) {
+      i++;
+    }
+    return i;
+  }
+  size_t lastNonEmpty() const {
+    size_t i = counts_.size();
+    while (i > 0 && counts_[i - 1] == 0) {
+      i--;
+    }
+    return i == 0 ? 0 : i - 1;
+  }
+
+ private:
+  unsigned bits_;
+  std::vector<uint64_t> counts_;
+  uint64_t total_ = 0;
+};
+
+// LogLinearHistogram bins with fractional weights, for sampled data where
+// each recorded value stands for 1/rate values (and bytes).
+struct WeightedHistogram {
+  LogLinearHistogram bins;
+  std::vector<double> counts;
+  std::vector<double> bytes;
+
+  explicit WeightedHistogram(unsigned subBucketBits = 2)
+      : bins(subBucketBits), counts(bins.numBuckets(), 0), bytes(bins.numBuckets(), 0) {}
+
+  void record(uint64_t value, double weight, double weightBytes = 0) {
+    size_t i = bins.indexOf(value);
+    counts[i] += weight;
+    bytes[i] += weightBytes;
+  }
+
+  double total() const {
+    double sum = 0;
+    for (double c : counts) {
+      sum += c;
+    }
+    return sum;
+  }
+};
+
+}  // namespace trace
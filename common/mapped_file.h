@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace trace {
+
+// Read-only memory mapping of a whole input file.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { close(); }
+
+  // Prints the reason to std::cerr and returns false on failure.
+  bool open(const std::string &path);
+  void close();
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+  std::string_view view() const { return {data_, size_}; }
+
+ private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+}  // namespace trace
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "md5.h"
+
+namespace trace {
+
+// Hex MD5 digest of `input`, cut to its first `length` characters. This is
+// the key anonymization hash_key writes and check_hash_conflict checks.
+inline std::string md5Truncate(const std::string &input, size_t length = 16) {
+  Chocobo1::MD5 md5;
+  md5.addData(input.data(), input.size()).finalize();
+  std::string hashHex = md5.toString();
+  if (hashHex.size() > length) {
+    return hashHex.substr(0, length);
+  }
+  return hashHex;
+}
+
+}  // namespace trace
@@ -0,0 +1,135 @@
+#include "common/memory_stats.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+namespace trace {
+
+namespace {
+
+// Each thread counts into a slot of its own with plain loads and stores, so
+// an allocation costs no locked instruction and no shared cache line;
+// allocationStats() sums the slots. A thread hands its slot back when it
+// exits, folding its counts into g_retired, so the threads parallelFor
+// spawns for every window reuse a few slots. Threads that find none free
+// count into g_retired directly.
+struct alignas(64) Slot {
+  std::atomic<bool> used{false};
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> freed{0};
+};
+
+constexpr size_t SLOTS = 256;
+Slot g_slots[SLOTS];
+Slot g_retired;
+
+thread_local Slot *t_slot = nullptr;
+thread_local bool t_shared = false;  // no slot of its own, or exiting
+
+void fold(std::atomic<uint64_t> &from, std::atomic<uint64_t> &to) {
+  to.fetch_add(from.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+struct SlotRelease {
+  bool armed = false;
+  ~SlotRelease() {
+    t_shared = true;
+    if (t_slot != nullptr) {
+      fold(t_slot->allocations, g_retired.allocations);
+      fold(t_slot->bytes, g_retired.bytes);
+      fold(t_slot->freed, g_retired.freed);
+      t_slot->used.store(false, std::memory_order_release);
+      t_slot = nullptr;
+    }
+  }
+};
+thread_local SlotRelease t_release;
+
+Slot *threadSlot() {
+  if (t_slot != nullptr || t_shared) {
+    return t_slot;
+  }
+  t_shared = true;
+  for (Slot &slot : g_slots) {
+    bool expected = false;
+    if (!slot.used.load(std::memory_order_relaxed) &&
+        slot.used.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+      t_slot = &slot;
+      t_shared = false;
+      // Registers the destructor that hands the slot back. glibc keeps the
+      // registration with calloc, which does not come back here.
+      t_release.armed = true;
+      break;
+    }
+  }
+  return t_slot;
+}
+
+void add(Slot *slot, std::atomic<uint64_t> Slot::*counter, uint64_t n) {
+  if (slot != nullptr) {
+    std::atomic<uint64_t> &value = slot->*counter;
+    value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  } else {
+    (g_retired.*counter).fetch_add(n, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace
+
+void countAllocation(uint64_t bytes) {
+  Slot *slot = threadSlot();
+  add(slot, &Slot::allocations, 1);
+  add(slot, &Slot::bytes, bytes);
+}
+
+void countFree(uint64_t bytes) { add(threadSlot(), &Slot::freed, bytes); }
+
+AllocationStats allocationStats() {
+  uint64_t freed = g_retired.freed.load(std::memory_order_relaxed);
+  AllocationStats stats;
+  stats.allocations = g_retired.allocations.load(std::memory_order_relaxed);
+  stats.bytes = g_retired.bytes.load(std::memory_order_relaxed);
+  for (const Slot &slot : g_slots) {
+    stats.allocations += slot.allocations.load(std::memory_order_relaxed);
+    stats.bytes += slot.bytes.load(std::memory_order_relaxed);
+    freed += slot.freed.load(std::memory_order_relaxed);
+  }
+  stats.liveBytes = stats.bytes > freed ? stats.bytes - freed : 0;
+  return stats;
+}
+
+uint64_t currentRssBytes() {
+  // statm: size resident shared ..., in pages.
+  std::ifstream in("/proc/self/statm");
+  uint64_t size = 0;
+  uint64_t resident = 0;
+  if (!(in >> size >> resident)) {
+    return 0;
+  }
+  return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+uint64_t peakRssBytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+uint64_t physicalMemoryBytes() {
+  std::ifstream in("/proc/meminfo");
+  std::string name;
+  uint64_t kb = 0;
+  std::string unit;
+  while (in >> name >> kb >> unit) {
+    if (name == "MemTotal:") {
+      return kb * 1024;
+    }
+  }
+  return 0;
+}
+
+}  // namespace trace
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace trace {
+
+// ----------------------------------------------------------------
+// Process memory and hash table health.
+//
+// Allocation counts come from the operator new/delete replacements in
+// common/alloc_hooks.cpp, which the tools link unless built with
+// -DTRACE_ALLOC_HOOKS=OFF; elsewhere they stay 0. Each thread counts on its
+// own, and allocationStats() sums the threads. Map health is sampled by the thread that owns the map and
+// handed to ProgressReporter::publishMap, which prints it together with a
+// projected peak RSS at the end of the input.
+// ----------------------------------------------------------------
+struct AllocationStats {
+  uint64_t allocations = 0;  // operator new calls so far
+  uint64_t bytes = 0;        // bytes they returned, as malloc_usable_size
+  uint64_t liveBytes = 0;    // of those, not yet deleted
+};
+
+AllocationStats allocationStats();
+
+// For common/alloc_hooks.cpp.
+void countAllocation(uint64_t bytes);
+void countFree(uint64_t bytes);
+
+uint64_t currentRssBytes();
+uint64_t peakRssBytes();
+// MemTotal of /proc/meminfo, 0 if unknown.
+uint64_t physicalMemoryBytes();
+
+struct MapHealth {
+  uint64_t size = 0;
+  uint64_t buckets = 0;
+  uint64_t tableBytes = 0;  // the bucket array, without what entries own
+  uint64_t maxSize = 0;     // entries before the next rehash
+
+  double loadFactor() const { return buckets ? static_cast<double>(size) / buckets : 0; }
+  double bytesPerEntry() const { return size ? static_cast<double>(tableBytes) / size : 0; }
+};
+
+// Health of a robin_hood map or set.
+template <typename Map>
+MapHealth mapHealth(const Map &map) {
+  MapHealth health;
+  health.size = map.size();
+  if (map.mask() > 0) {
+    health.buckets = map.mask() + 1;
+    health.tableBytes = map.calcNumBytesTotal(map.calcNumElementsWithBuffer(health.buckets));
+    health.maxSize = map.calcMaxNumElementsAllowed(health.buckets);
+  }
+  return health;
+}
+
+}  // namespace trace
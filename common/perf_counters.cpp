@@ -0,0 +1,154 @@
+#include "common/perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+namespace {
+
+std::mutex g_reasonMutex;
+std::string g_reason;
+
+uint64_t cacheEvent(uint64_t cache, uint64_t op, uint64_t result) {
+  return cache | (op << 8) | (result << 16);
+}
+
+// Candidate (type, config) pairs per event, most specific first.
+struct EventConfig {
+  uint32_t type;
+  uint64_t config;
+};
+
+int openEvent(const EventConfig &event, int groupFd) {
+  struct perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+std::string paranoidLevel() {
+  std::ifstream in("/proc/sys/kernel/perf_event_paranoid");
+  std::string level;
+  return in >> level ? level : "unknown";
+}
+
+void setReason(const std::string &reason) {
+  std::lock_guard<std::mutex> lock(g_reasonMutex);
+  if (g_reason.empty()) {
+    g_reason = reason;
+    std::cerr << "TRACE_PERF: " << reason << "; continuing without counters\n";
+  }
+}
+
+}  // namespace
+
+const char *perfEventName(PerfEvent event) {
+  switch (event) {
+  case PerfEvent::Cycles: return "cycles";
+  case PerfEvent::Instructions: return "instructions";
+  case PerfEvent::LlcMisses: return "llc_misses";
+  case PerfEvent::BranchMisses: return "branch_misses";
+  case PerfEvent::DtlbMisses: return "dtlb_misses";
+  }
+  return "unknown";
+}
+
+PerfCounters::PerfCounters() {
+  static const std::vector<EventConfig> candidates[NUM_PERF_EVENTS] = {
+      {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES}},
+      {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS}},
+      {{PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ,
+                                       PERF_COUNT_HW_CACHE_RESULT_MISS)},
+       {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}},
+      {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}},
+      {{PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                       PERF_COUNT_HW_CACHE_RESULT_MISS)}},
+  };
+  int firstErrno = 0;
+  for (size_t i = 0; i < NUM_PERF_EVENTS; ++i) {
+    fds_[i] = -1;
+    slot_[i] = -1;
+    for (const auto &candidate : candidates[i]) {
+      int fd = openEvent(candidate, leader_);
+      if (fd >= 0) {
+        fds_[i] = fd;
+        slot_[i] = static_cast<int>(opened_++);
+        if (leader_ < 0) {
+          leader_ = fd;
+        }
+        break;
+      }
+      if (firstErrno == 0) {
+        firstErrno = errno;
+      }
+    }
+  }
+  if (opened_ == 0) {
+    setReason(std::string("perf_event_open failed: ") + std::strerror(firstErrno) +
+              " (perf_event_paranoid=" + paranoidLevel() + ")");
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+}
+
+bool PerfCounters::enabled() {
+  static const bool on = [] {
+    const char *value = std::getenv("TRACE_PERF");
+    return value != nullptr && *value != '\0' && std::strcmp(value, "0") != 0;
+  }();
+  return on;
+}
+
+PerfCounters *PerfCounters::forThisThread() {
+  if (!enabled()) {
+    return nullptr;
+  }
+  thread_local std::unique_ptr<PerfCounters> counters(new PerfCounters());
+  return counters->opened_ > 0 ? counters.get() : nullptr;
+}
+
+std::string PerfCounters::unavailableReason() {
+  std::lock_guard<std::mutex> lock(g_reasonMutex);
+  return g_reason;
+}
+
+void PerfCounters::read(PerfValues &values) const {
+  // nr, time_enabled, time_running, then one value per opened event.
+  uint64_t buffer[3 + NUM_PERF_EVENTS] = {};
+  values = PerfValues();
+  ssize_t want = static_cast<ssize_t>((3 + opened_) * sizeof(uint64_t));
+  if (::read(leader_, buffer, sizeof(buffer)) < want || buffer[2] == 0) {
+    return;
+  }
+  double scale = static_cast<double>(buffer[1]) / buffer[2];
+  for (size_t i = 0; i < NUM_PERF_EVENTS; ++i) {
+    if (slot_[i] >= 0) {
+      values.counts[i] = static_cast<uint64_t>(buffer[3 + slot_[i]] * scale);
+    }
+  }
+}
+
+}  // namespace trace
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace trace {
+
+// ----------------------------------------------------------------
+// Hardware performance counters of the calling thread, through
+// perf_event_open(2).
+//
+// Opt-in with TRACE_PERF=1 (together with TRACE_REPORT); StageTimer then
+// reads them around every timed scope and the run report gets per-stage
+// IPC, LLC, branch and dTLB misses. Only user space is counted, which
+// perf_event_paranoid <= 2 (the usual default) allows without root. Events
+// the CPU or hypervisor does not expose are left out; when none can be
+// opened the tools run as usual and the report says why.
+// ----------------------------------------------------------------
+enum class PerfEvent { Cycles, Instructions, LlcMisses, BranchMisses, DtlbMisses };
+constexpr size_t NUM_PERF_EVENTS = 5;
+
+const char *perfEventName(PerfEvent event);
+
+struct PerfValues {
+  uint64_t counts[NUM_PERF_EVENTS] = {};
+};
+
+class PerfCounters {
+ public:
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+  ~PerfCounters();
+
+  // Whether TRACE_PERF is set; read once.
+  static bool enabled();
+
+  // The counters of this thread, opened on first use. nullptr when
+  // disabled or when no event could be opened.
+  static PerfCounters *forThisThread();
+
+  // Empty while the counters work (or are disabled), else why they don't.
+  static std::string unavailableReason();
+
+  // Current counts, scaled up when the kernel multiplexed the group.
+  // Events that could not be opened read 0.
+  void read(PerfValues &values) const;
+
+  bool has(PerfEvent event) const { return slot_[static_cast<size_t>(event)] >= 0; }
+
+ private:
+  PerfCounters();
+
+  int leader_ = -1;
+  int fds_[NUM_PERF_EVENTS];
+  int slot_[NUM_PERF_EVENTS];  // position in the group read, or -1
+  size_t opened_ = 0;
+};
+
+}  // namespace trace
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace trace {
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel Random
+// Numbers: As Easy as 1, 2, 3", SC'11).
+//
+// There is no state to advance: the output is a pure function of (key,
+// counter), so any thread can draw the random number for line/window i
+// directly and the result does not depend on how work is split.
+class Philox4x32 {
+ public:
+  using Counter = std::array<uint32_t, 4>;
+
+  explicit Philox4x32(uint64_t seed)
+      : key0_(static_cast<uint32_t>(seed)),
+        key1_(static_cast<uint32_t>(seed >> 32)) {}
+
+  Counter operator()(Counter ctr) const {
+    uint32_t k0 = key0_;
+    uint32_t k1 = key1_;
+    for (int round = 0; round < 10; ++round) {
+      if (round > 0) {
+        k0 += kWeyl0;
+        k1 += kWeyl1;
+      }
+      uint64_t p0 = static_cast<uint64_t>(kMul0) * ctr[0];
+      uint64_t p1 = static_cast<uint64_t>(kMul1) * ctr[2];
+      ctr = {static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ k0,
+             static_cast<uint32_t>(p1),
+             static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ k1,
+             static_cast<uint32_t>(p0)};
+    }
+    return ctr;
+  }
+
+  // 64 random bits for (stream, index). `stream` separates independent uses
+  // of the same seed.
+  uint64_t bits(uint64_t stream, uint64_t index) const {
+    Counter out = (*this)({static_cast<uint32_t>(index),
+                           static_cast<uint32_t>(index >> 32),
+                           static_cast<uint32_t>(stream),
+                           static_cast<uint32_t>(stream >> 32)});
+    return (static_cast<uint64_t>(out[0]) << 32) | out[1];
+  }
+
+  // Uniform integer in [0, bound). The modulo bias of a 64-bit draw is far
+  // below anything the trace sizes can resolve.
+  uint64_t below(uint64_t stream, uint64_t index, uint64_t bound) const {
+    return bits(stream, index) % bound;
+  }
+
+  // Uniform double in [0, 1).
+  double uniform(uint64_t stream, uint64_t index) const {
+    return static_cast<double>(bits(stream, index) >> 11) * 0x1.0p-53;
+  }
+
+ private:
+  static constexpr uint32_t kMul0 = 0xD2511F53;
+  static constexpr uint32_t kMul1 = 0xCD9E8D57;
+  static constexpr uint32_t kWeyl0 = 0x9E3779B9;
+  static constexpr uint32_t kWeyl1 = 0xBB67AE85;
+
+  uint32_t key0_;
+  uint32_t key1_;
+};
+
+}  // namespace trace
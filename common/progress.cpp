@@ -0,0 +1,179 @@
+#include "common/progress.h"
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+
+#include "include/fmt/core.h"
+
+namespace trace {
+
+namespace {
+
+// Seconds between lines from TRACE_PROGRESS; 0 means off.
+double progressInterval() {
+  const char *value = std::getenv("TRACE_PROGRESS");
+  if (value == nullptr || *value == '\0') {
+    return 10;
+  }
+  return std::max(0.0, std::strtod(value, nullptr));
+}
+
+std::string formatDuration(double seconds) {
+  uint64_t s = static_cast<uint64_t>(seconds);
+  if (s >= 3600) {
+    return fmt::format("{}h{:02}m", s / 3600, s / 60 % 60);
+  }
+  if (s >= 60) {
+    return fmt::format("{}m{:02}s", s / 60, s % 60);
+  }
+  return fmt::format("{}s", s);
+}
+
+}  // namespace
+
+ProgressReporter::ProgressReporter(std::string label, uint64_t totalBytes)
+    : label_(std::move(label)), totalBytes_(totalBytes) {
+  if (progressInterval() > 0) {
+    thread_ = std::thread(&ProgressReporter::run, this);
+  }
+}
+
+ProgressReporter::~ProgressReporter() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+}
+
+void ProgressReporter::run() {
+  // Lowest priority for this thread only; Linux applies nice per thread.
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+
+  auto interval = std::chrono::duration<double>(progressInterval());
+  auto start = std::chrono::steady_clock::now();
+  uint64_t startRss = currentRssBytes();
+  auto last = start;
+  uint64_t lastBytes = 0;
+  double rate = 0;  // bytes per second, smoothed over intervals
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!wake_.wait_for(lock, interval, [this] { return stop_; })) {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t bytes = bytes_.load(std::memory_order_relaxed);
+    double seconds = std::chrono::duration<double>(now - last).count();
+    double recent = seconds > 0 ? (bytes - lastBytes) / seconds : 0;
+    rate = rate == 0 ? recent : 0.7 * rate + 0.3 * recent;
+    last = now;
+    lastBytes = bytes;
+    print(std::chrono::duration<double>(now - start).count(), rate);
+    if (numMaps_ > 0) {
+      printMemory(startRss);
+    }
+  }
+}
+
+int ProgressReporter::addMap(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (numMaps_ == MAX_MAPS) {
+    return -1;
+  }
+  maps_[numMaps_].name = name;
+  return numMaps_++;
+}
+
+// The projection scales what grew since the start by the inverse of the
+// fraction done, except the map tables: those double when they fill up,
+// so each is projected to the power of two its projected size needs, plus
+// the old table that is still alive while the largest one rehashes.
+void ProgressReporter::printMemory(uint64_t startRss) {
+  uint64_t rss = currentRssBytes();
+  AllocationStats heap = allocationStats();
+  std::string line = fmt::format("{} memory: rss {:.2f} GB (peak {:.2f} GB)", label_,
+                                 rss / 1e9, peakRssBytes() / 1e9);
+  if (heap.allocations > 0) {
+    line += fmt::format(", heap {:.2f} GB live, {:.1f}M allocations of {:.2f} GB",
+                        heap.liveBytes / 1e9, heap.allocations / 1e6, heap.bytes / 1e9);
+  }
+
+  uint64_t bytes = bytes_.load(std::memory_order_relaxed);
+  double fraction = totalBytes_ > 0 ? static_cast<double>(bytes) / totalBytes_ : 0;
+  uint64_t tables = 0;
+  double projectedTables = 0;
+  double rehash = 0;
+  for (int i = 0; i < numMaps_; ++i) {
+    const MapSlot &map = maps_[i];
+    MapHealth health;
+    health.size = map.size.load(std::memory_order_relaxed);
+    health.buckets = map.buckets.load(std::memory_order_relaxed);
+    health.tableBytes = map.tableBytes.load(std::memory_order_relaxed);
+    health.maxSize = map.maxSize.load(std::memory_order_relaxed);
+    line += fmt::format("; {}: {:.2f}M entries, load {:.2f}, {:.1f} B/entry", map.name,
+                        health.size / 1e6, health.loadFactor(), health.bytesPerEntry());
+    tables += health.tableBytes;
+    if (fraction > 0 && health.maxSize > 0) {
+      double projectedSize = health.size / fraction;
+      double growth = 1;
+      while (projectedSize > health.maxSize * growth) {
+        growth *= 2;
+      }
+      projectedTables += health.tableBytes * growth;
+      if (growth > 1) {
+        rehash = std::max(rehash, health.tableBytes * growth / 2);
+      }
+    }
+  }
+
+  if (fraction >= 0.01) {
+    uint64_t other = rss > tables ? rss - tables : 0;
+    double grown = other > startRss ? static_cast<double>(other - startRss) : 0;
+    double projected = std::max<double>(
+        peakRssBytes(), startRss + grown / std::min(1.0, fraction) + projectedTables + rehash);
+    line += fmt::format("; projected peak {:.2f} GB", projected / 1e9);
+    uint64_t physical = physicalMemoryBytes();
+    if (!warnedMemory_ && physical > 0 && projected > physical) {
+      warnedMemory_ = true;
+      line += fmt::format("\n{}: warning: the projected peak exceeds the {:.2f} GB of "
+                          "physical memory",
+                          label_, physical / 1e9);
+    }
+  }
+  std::cerr << line + "\n" << std::flush;
+}
+
+void ProgressReporter::print(double elapsedSeconds, double bytesPerSecond) const {
+  uint64_t bytes = bytes_.load(std::memory_order_relaxed);
+  uint64_t rows = rows_.load(std::memory_order_relaxed);
+  std::string line = fmt::format("{}: {:.2f} GB", label_, bytes / 1e9);
+  if (totalBytes_ > 0) {
+    line += fmt::format(" of {:.2f} GB ({:.1f}%)", totalBytes_ / 1e9,
+                        std::min(100.0, 100.0 * bytes / totalBytes_));
+  }
+  line += fmt::format(", {:.1f}M rows, {:.1f} MB/s, {} elapsed", rows / 1e6,
+                      bytesPerSecond / 1e6, formatDuration(elapsedSeconds));
+  if (totalBytes_ > bytes && bytesPerSecond > 0) {
+    line += ", ETA " + formatDuration((totalBytes_ - bytes) / bytesPerSecond);
+  }
+  std::cerr << line + "\n" << std::flush;
+}
+
+uint64_t fileBytes(const std::vector<std::string> &paths) {
+  uint64_t total = 0;
+  for (const auto &path : paths) {
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(path, error);
+    total += error ? 0 : size;
+  }
+  return total;
+}
+
+}  // namespace trace
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/memory_stats.h"
+
+namespace trace {
+
+// ----------------------------------------------------------------
+// Progress and ETA on stderr.
+//
+// A background thread at the lowest CPU priority wakes every
+// TRACE_PROGRESS seconds (default 10, 0 turns it off), samples the byte and
+// row counters and prints one line with throughput and, when the input
+// size is known, the percentage done and the ETA. The hot loops only add
+// to counters; they never wait for or print anything.
+//
+//   trace::ProgressReporter progress("trace_info", trace::fileBytes(files));
+//   trace::ProgressReporter::Batch counted(progress);   // per thread
+//   counted.add(1, line.size() + 1);                    // per row
+//
+// Tools that hold large maps register them with addMap() and publish
+// their health now and then from the owning thread; every progress line is
+// then followed by a memory line with RSS, heap allocations, each map's
+// size, load factor and table bytes per entry, and the peak RSS projected
+// for the end of the input.
+// ----------------------------------------------------------------
+class ProgressReporter {
+ public:
+  // `totalBytes` is the input size, 0 if unknown.
+  ProgressReporter(std::string label, uint64_t totalBytes);
+  ~ProgressReporter();
+  ProgressReporter(const ProgressReporter &) = delete;
+  ProgressReporter &operator=(const ProgressReporter &) = delete;
+
+  void add(uint64_t rows, uint64_t bytes) {
+    rows_.fetch_add(rows, std::memory_order_relaxed);
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  // Registers a map shown on the memory lines; returns its slot, or -1
+  // when all slots are taken. Call before the map is published.
+  int addMap(const std::string &name);
+
+  // Latest health of the map in `slot`; cheap enough for every few
+  // hundred thousand rows.
+  void publishMap(int slot, const MapHealth &health) {
+    if (slot < 0) {
+      return;
+    }
+    MapSlot &map = maps_[slot];
+    map.size.store(health.size, std::memory_order_relaxed);
+    map.buckets.store(health.buckets, std::memory_order_relaxed);
+    map.tableBytes.store(health.tableBytes, std::memory_order_relaxed);
+    map.maxSize.store(health.maxSize, std::memory_order_relaxed);
+  }
+
+  // Counts one thread's rows in plain integers and adds them to the
+  // reporter every few thousand rows and when destroyed.
+  class Batch {
+   public:
+    explicit Batch(ProgressReporter &reporter) : reporter_(reporter) {}
+    ~Batch() { flush(); }
+    Batch(const Batch &) = delete;
+    Batch &operator=(const Batch &) = delete;
+
+    void add(uint64_t rows, uint64_t bytes) {
+      rows_ += rows;
+      bytes_ += bytes;
+      if (rows_ >= 4096) {
+        flush();
+      }
+    }
+    void flush() {
+      reporter_.add(rows_, bytes_);
+      rows_ = 0;
+      bytes_ = 0;
+    }
+
+   private:
+    ProgressReporter &reporter_;
+    uint64_t rows_ = 0;
+    uint64_t bytes_ = 0;
+  };
+
+ private:
+  static const int MAX_MAPS = 8;
+
+  struct MapSlot {
+    std::string name;
+    std::atomic<uint64_t> size{0};
+    std::atomic<uint64_t> buckets{0};
+    std::atomic<uint64_t> tableBytes{0};
+    std::atomic<uint64_t> maxSize{0};
+  };
+
+  void run();
+  void print(double elapsedSeconds, double bytesPerSecond) const;
+  void printMemory(uint64_t startRss);
+
+  std::string label_;
+  uint64_t totalBytes_;
+  std::atomic<uint64_t> rows_{0};
+  std::atomic<uint64_t> bytes_{0};
+  MapSlot maps_[MAX_MAPS];
+  std::mutex mutex_;          // guards the fields below
+  int numMaps_ = 0;
+  bool warnedMemory_ = false;
+  std::condition_variable wake_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+// Total size of the files; files that cannot be read count 0.
+uint64_t fileBytes(const std::vector<std::string> &paths);
+
+}  // namespace trace
@@ -0,0 +1,59 @@
+#include "common/raw_trace.h"
+
+#include <sstream>
+
+namespace trace {
+
+namespace {
+
+// Helper function to fix the key field by removing commas
+std::string fixKey(const std::vector<std::string>& fields, size_t startIdx, size_t endIdx) {
+    std::string fixedKey;
+    for (size_t i = startIdx; i <= endIdx; ++i) {
+        fixedKey += fields[i];
+    }
+    return fixedKey;
+}
+
+}  // namespace
+
+bool parseRawLine(const std::string& line, RawRow& row) {
+    std::istringstream ss(line);
+    std::string token;
+    std::vector<std::string> fields;
+
+    // Split line into tokens
+    while (std::getline(ss, token, ',')) {
+        fields.push_back(token);
+    }
+
+    // Ensure at least 7 fields exist
+    if (fields.size() < 7) {
+        return false; // Invalid row
+    }
+
+    // The key field may span multiple tokens
+    size_t keyEndIdx = fields.size() - 6;
+
+    try {
+        row.timestamp = std::stoull(fields[0]);
+        row.key = fixKey(fields, 1, keyEndIdx);
+        row.key_size = std::stoul(fields[keyEndIdx + 1]);
+        row.value_size = std::stoul(fields[keyEndIdx + 2]);
+        row.client_id = std::stoull(fields[keyEndIdx + 3]);
+        row.operation = fields[keyEndIdx + 4];
+        row.TTL = std::stoull(fields[keyEndIdx + 5]);
+    } catch (...) {
+        return false; // Conversion error
+    }
+
+    return true;
+}
+
+void writeRawRow(std::ostream& out, const RawRow& row) {
+    out << row.timestamp << "," << row.key << "," << row.key_size << ","
+        << row.value_size << "," << row.client_id << "," << row.operation << ","
+        << row.TTL << "\n";
+}
+
+}  // namespace trace
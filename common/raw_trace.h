@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace trace {
+
+// One row of a raw Twitter trace:
+// timestamp,key,key_size,value_size,client_id,op,TTL
+struct RawRow {
+    uint64_t timestamp;
+    std::string key;
+    uint32_t key_size;
+    uint32_t value_size;
+    uint64_t client_id;
+    std::string operation;
+    uint64_t TTL;
+};
+
+// Parses one raw line. Keys that contain commas span several tokens and
+// are glued back together without the commas. Returns false for invalid
+// rows.
+bool parseRawLine(const std::string& line, RawRow& row);
+
+void writeRawRow(std::ostream& out, const RawRow& row);
+
+}  // namespace trace
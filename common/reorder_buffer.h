@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace trace {
+
+// Re-sorts a nearly sorted stream inside a bounded time window.
+//
+// Items are held in a min-heap until the newest timestamp seen is at least
+// `window` ahead of them; at that point no in-window row can still precede
+// them and they are released in timestamp order. Items with equal
+// timestamps keep their input order.
+//
+// A row whose timestamp is older than the last released one arrived later
+// than the window allows. It is still released (as soon as possible, so no
+// data is lost) but counted in lateCount() so the caller can report it and
+// re-run with a larger window.
+template <typename T, typename TimestampOf>
+class ReorderBuffer {
+ public:
+  explicit ReorderBuffer(uint64_t window, TimestampOf timestampOf = {})
+      : window_(window), timestampOf_(std::move(timestampOf)) {}
+
+  void push(T item) {
+    uint64_t ts = timestampOf_(item);
+    if (released_ && ts < lastReleased_) {
+      lateCount_++;
+    }
+    if (ts > newest_) {
+      newest_ = ts;
+    }
+    heap_.push(Slot{ts, seq_++, std::move(item)});
+  }
+
+  // True when the oldest buffered item can no longer be preceded by a row
+  // that is still inside the window.
+  bool hasReady() const {
+    return !heap_.empty() && heap_.top().ts + window_ <= newest_;
+  }
+
+  bool empty() const { return heap_.empty(); }
+  size_t size() const { return heap_.size(); }
+
+  // Removes the oldest buffered item. Must not be called when empty().
+  T pop() {
+    Slot top = std::move(const_cast<Slot &>(heap_.top()));
+    heap_.pop();
+    if (!released_ || top.ts > lastReleased_) {
+      lastReleased_ = top.ts;
+    }
+    released_ = true;
+    return std::move(top.item);
+  }
+
+  uint64_t window() const { return window_; }
+  uint64_t lateCount() const { return lateCount_; }
+
+ private:
+  struct Slot {
+    uint64_t ts;
+    uint64_t seq;
+    T item;
+
+    // std::priority_queue is a max-heap; invert to pop the oldest first.
+    bool operator<(const Slot &other) const {
+      if (ts != other.ts) {
+        return ts > other.ts;
+      }
+      return seq > other.seq;
+    }
+  };
+
+  uint64_t window_;
+  TimestampOf timestampOf_;
+  std::priority_queue<Slot> heap_;
+  uint64_t seq_ = 0;
+  uint64_t newest_ = 0;
+  uint64_t lastReleased_ = 0;
+  bool released_ = false;
+  uint64_t lateCount_ = 0;
+};
+
+}  // namespace trace
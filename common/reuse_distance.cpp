@@ -0,0 +1,65 @@
+#include "common/reuse_distance.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace trace {
+
+ReuseDistance::ReuseDistance(Weight weight, uint32_t initialSlots)
+    : weight_(weight),
+      owner_(std::max<uint32_t>(initialSlots, 2), EMPTY),
+      tree_(owner_.size(), 0) {}
+
+bool ReuseDistance::erase(uint64_t keyHash) {
+  auto it = index_.find(keyHash);
+  if (it == index_.end()) {
+    return false;
+  }
+  uint32_t entry = it->second;
+  index_.erase(it);
+  Entry &e = entries_[entry];
+  add(e.slot, -static_cast<int64_t>(slotWeight(e)));
+  owner_[e.slot] = EMPTY;
+  // Keep entries_ dense: the last entry takes the erased one's place.
+  if (entry + 1 != entries_.size()) {
+    e = entries_.back();
+    owner_[e.slot] = entry;
+    index_[e.keyHash] = entry;
+  }
+  entries_.pop_back();
+  return true;
+}
+
+void ReuseDistance::compact() {
+  size_t slots = owner_.size();
+  if (entries_.size() + 1 > slots / 2) {
+    if (slots >= UINT32_MAX / 2) {
+      throw std::length_error("ReuseDistance: more than 2^31 distinct keys");
+    }
+    slots *= 2;
+  }
+  std::vector<uint32_t> owner(slots, EMPTY);
+  std::vector<uint64_t> tree(slots, 0);
+  uint32_t next = 1;
+  for (uint32_t slot = 1; slot < next_; ++slot) {
+    uint32_t entry = owner_[slot];
+    if (entry != EMPTY) {
+      entries_[entry].slot = next;
+      owner[next] = entry;
+      tree[next] = slotWeight(entries_[entry]);
+      next++;
+    }
+  }
+  // Linear-time Fenwick build: push each node's sum into its parent.
+  for (size_t i = 1; i < slots; ++i) {
+    size_t parent = i + (i & (~i + 1));
+    if (parent < slots) {
+      tree[parent] += tree[i];
+    }
+  }
+  owner_.swap(owner);
+  tree_.swap(tree);
+  next_ = next;
+}
+
+}  // namespace trace
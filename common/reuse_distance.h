@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "include/robin_hood/robin_hood.h"
+
+namespace trace {
+
+// ----------------------------------------------------------------
+// Exact LRU stack distance, O(log N) per request.
+//
+// Every key owns one slot on a time axis: the position of its latest
+// access. A Fenwick tree over the axis holds each live slot's weight (1,
+// or the object size when weighing by bytes), so the distinct keys, or
+// their bytes, touched since a key's previous access are one prefix sum.
+// When the axis fills up the live slots are renumbered in access order and
+// the tree is rebuilt, which keeps it at most twice the number of keys.
+//
+// The distance returned is the LRU cache size a request needs to hit: 1
+// (or its own size) for an immediate re-reference, 0 for a cold miss.
+// ----------------------------------------------------------------
+class ReuseDistance {
+ public:
+  enum class Weight { Objects, Bytes };
+
+  explicit ReuseDistance(Weight weight, uint32_t initialSlots = 1u << 20);
+
+  // Records an access of `keyHash` with object size `size` and returns its
+  // distance.
+  uint64_t access(uint64_t keyHash, uint32_t size) {
+    uint64_t weight = weight_ == Weight::Bytes ? size : 1;
+    if (next_ == owner_.size()) {
+      compact();
+    }
+    auto inserted = index_.try_emplace(keyHash, static_cast<uint32_t>(entries_.size()));
+    uint64_t distance = 0;
+    uint32_t entry = inserted.first->second;
+    if (inserted.second) {
+      entries_.push_back({keyHash, 0, 0});
+    } else {
+      Entry &e = entries_[entry];
+      // The key's own slot and everything after it.
+      distance = total_ - prefix(e.slot - 1);
+      add(e.slot, -static_cast<int64_t>(slotWeight(e)));
+      owner_[e.slot] = EMPTY;
+    }
+    Entry &e = entries_[entry];
+    e.slot = next_;
+    e.size = size;
+    owner_[next_] = entry;
+    add(next_, static_cast<int64_t>(weight));
+    next_++;
+    return distance;
+  }
+
+  // Drops `keyHash` from the stack, as if it had never been requested;
+  // false if it is not there.
+  bool erase(uint64_t keyHash);
+
+  uint64_t keys() const { return entries_.size(); }
+  const robin_hood::unordered_flat_map<uint64_t, uint32_t> &index() const { return index_; }
+
+ private:
+  static constexpr uint32_t EMPTY = UINT32_MAX;
+
+  struct Entry {
+    uint64_t keyHash;
+    uint32_t slot;  // 1-based position of the latest access
+    uint32_t size;  // object size at that access
+  };
+
+  uint64_t slotWeight(const Entry &e) const { return weight_ == Weight::Bytes ? e.size : 1; }
+
+  // Fenwick tree over slots 1..owner_.size()-1.
+  void add(uint32_t slot, int64_t delta) {
+    total_ += static_cast<uint64_t>(delta);
+    for (size_t i = slot; i < tree_.size(); i += i & (~i + 1)) {
+      tree_[i] += static_cast<uint64_t>(delta);
+    }
+  }
+  uint64_t prefix(uint32_t slot) const {
+    uint64_t sum = 0;
+    for (size_t i = slot; i > 0; i -= i & (~i + 1)) {
+      sum += tree_[i];
+    }
+    return sum;
+  }
+
+  // Renumbers the live slots 1..keys() in access order, grows the axis
+  // when more than half of it would stay in use, and rebuilds the tree.
+  void compact();
+
+  Weight weight_;
+  robin_hood::unordered_flat_map<uint64_t, uint32_t> index_;  // key hash -> entry
+  std::vector<Entry> entries_;
+  std::vector<uint32_t> owner_;  // slot -> entry, EMPTY if stale; slot 0 unused
+  std::vector<uint64_t> tree_;
+  uint32_t next_ = 1;
+  uint64_t total_ = 0;
+};
+
+}  // namespace trace
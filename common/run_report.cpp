@@ -0,0 +1,235 @@
+#include "common/run_report.h"
+
+#include <sys/resource.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "common/memory_stats.h"
+#include "include/fmt/core.h"
+
+namespace trace {
+
+namespace {
+
+RunReport *g_current = nullptr;
+
+std::string jsonString(const std::string &text) {
+  std::string out = "\"";
+  for (char c : text) {
+    switch (c) {
+    case '"': out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\n': out += "\\n"; break;
+    case '\t': out += "\\t"; break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        out += fmt::format("\\u{:04x}", static_cast<unsigned>(c));
+      } else {
+        out += c;
+      }
+    }
+  }
+  return out + "\"";
+}
+
+double seconds(const struct timeval &tv) { return tv.tv_sec + tv.tv_usec / 1e6; }
+
+// Estimated per-stage totals of the opened events, IPC and misses per row.
+void writeCounters(std::ostream &json, const StageTotals &s) {
+  double cycles = s.counter(PerfEvent::Cycles);
+  double instructions = s.counter(PerfEvent::Instructions);
+  if (cycles == 0 && instructions == 0) {
+    return;
+  }
+  json << ", \"counters\": {";
+  for (size_t i = 0; i < NUM_PERF_EVENTS; ++i) {
+    json << fmt::format("{}\"{}\": {:.0f}", i ? ", " : "",
+                        perfEventName(static_cast<PerfEvent>(i)),
+                        s.counter(static_cast<PerfEvent>(i)));
+  }
+  json << fmt::format(", \"ipc\": {:.3f}", cycles > 0 ? instructions / cycles : 0.0);
+  for (PerfEvent event : {PerfEvent::LlcMisses, PerfEvent::BranchMisses, PerfEvent::DtlbMisses}) {
+    json << fmt::format(", \"{}_per_row\": {:.4f}", perfEventName(event),
+                        s.rows > 0 ? s.counter(event) / s.rows : 0.0);
+  }
+  json << "}";
+}
+
+}  // namespace
+
+const char *stageName(Stage stage) {
+  switch (stage) {
+  case Stage::Generate: return "generate";
+  case Stage::Read: return "read";
+  case Stage::Parse: return "parse";
+  case Stage::Filter: return "filter";
+  case Stage::Hash: return "hash";
+  case Stage::Aggregate: return "aggregate";
+  case Stage::Write: return "write";
+  }
+  return "unknown";
+}
+
+double StageTotals::seconds() const {
+  double sampled = timedCalls == 0 ? 0.0
+                                   : static_cast<double>(timedNanos) * calls / timedCalls;
+  return (sampled + static_cast<double>(wholeNanos)) / 1e9;
+}
+
+double StageTotals::counter(PerfEvent event) const {
+  size_t i = static_cast<size_t>(event);
+  double sampled = timedCalls == 0
+                       ? 0.0
+                       : static_cast<double>(timedCounters.counts[i]) * calls / timedCalls;
+  return sampled + static_cast<double>(wholeCounters.counts[i]);
+}
+
+void StageTotals::merge(const StageTotals &other) {
+  calls += other.calls;
+  rows += other.rows;
+  bytes += other.bytes;
+  timedCalls += other.timedCalls;
+  timedNanos += other.timedNanos;
+  wholeNanos += other.wholeNanos;
+  latencyNanos.merge(other.latencyNanos);
+  for (size_t i = 0; i < NUM_PERF_EVENTS; ++i) {
+    timedCounters.counts[i] += other.timedCounters.counts[i];
+    wholeCounters.counts[i] += other.wholeCounters.counts[i];
+  }
+}
+
+RunReport::RunReport(std::string tool, int argc, char **argv)
+    : tool_(std::move(tool)), args_(argv, argv + argc),
+      start_(std::chrono::steady_clock::now()) {
+  g_current = this;
+}
+
+RunReport::~RunReport() {
+  if (enabled()) {
+    write();
+  }
+  g_current = nullptr;
+}
+
+bool RunReport::enabled() {
+  static const bool on = [] {
+    const char *path = std::getenv("TRACE_REPORT");
+    return path != nullptr && *path != '\0';
+  }();
+  return on;
+}
+
+RunReport *RunReport::current() { return g_current; }
+
+void RunReport::merge(Stage stage, const StageTotals &totals) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stages_[static_cast<size_t>(stage)].merge(totals);
+}
+
+void RunReport::note(const std::string &name, double value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  notes_.emplace_back(name, value);
+}
+
+void RunReport::write() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start_;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  std::ostringstream json;
+  json << "{\n";
+  json << "  \"tool\": " << jsonString(tool_) << ",\n";
+  json << "  \"args\": [";
+  for (size_t i = 0; i < args_.size(); ++i) {
+    json << (i ? ", " : "") << jsonString(args_[i]);
+  }
+  json << "],\n";
+  json << fmt::format("  \"wall_seconds\": {:.6f},\n", wall.count());
+  json << fmt::format("  \"cpu_seconds\": {:.6f},\n",
+                      seconds(usage.ru_utime) + seconds(usage.ru_stime));
+  json << fmt::format("  \"max_rss_kb\": {},\n", usage.ru_maxrss);
+  AllocationStats heap = allocationStats();
+  if (heap.allocations > 0) {
+    json << fmt::format("  \"allocations\": {},\n  \"allocated_bytes\": {},\n",
+                        heap.allocations, heap.bytes);
+  }
+  if (PerfCounters::enabled()) {
+    std::string reason = PerfCounters::unavailableReason();
+    json << "  \"perf\": " << jsonString(reason.empty() ? "on" : reason) << ",\n";
+  }
+  for (const auto &note : notes_) {
+    json << "  " << jsonString(note.first) << fmt::format(": {},\n", note.second);
+  }
+
+  const StageTotals *slowest = nullptr;
+  Stage slowestStage = Stage::Generate;
+  for (size_t i = 0; i < NUM_STAGES; ++i) {
+    if (slowest == nullptr || stages_[i].seconds() > slowest->seconds()) {
+      slowest = &stages_[i];
+      slowestStage = static_cast<Stage>(i);
+    }
+  }
+  json << "  \"bound_by\": "
+       << (slowest != nullptr && slowest->seconds() > 0 ? jsonString(stageName(slowestStage))
+                                                         : std::string("null"))
+       << ",\n";
+
+  json << "  \"stages\": {";
+  bool first = true;
+  for (size_t i = 0; i < NUM_STAGES; ++i) {
+    const StageTotals &s = stages_[i];
+    if (s.rows == 0 && s.bytes == 0 && s.seconds() == 0) {
+      continue;
+    }
+    double secs = s.seconds();
+    json << (first ? "\n" : ",\n");
+    first = false;
+    json << "    " << jsonString(stageName(static_cast<Stage>(i))) << ": {";
+    json << fmt::format("\"rows\": {}, \"bytes\": {}, \"seconds\": {:.6f}, ", s.rows, s.bytes,
+                        secs);
+    json << fmt::format("\"rows_per_second\": {:.1f}, \"mb_per_second\": {:.2f}, ",
+                        secs > 0 ? s.rows / secs : 0.0, secs > 0 ? s.bytes / secs / 1e6 : 0.0);
+    json << fmt::format("\"timed_calls\": {}", s.timedCalls);
+    if (s.latencyNanos.total() > 0) {
+      json << fmt::format(", \"latency_ns\": {{\"p50\": {}, \"p90\": {}, \"p99\": {}, "
+                          "\"max\": {}}}",
+                          s.latencyNanos.valueAtQuantile(0.5),
+                          s.latencyNanos.valueAtQuantile(0.9),
+                          s.latencyNanos.valueAtQuantile(0.99),
+                          s.latencyNanos.upperBound(s.latencyNanos.lastNonEmpty()));
+    }
+    writeCounters(json, s);
+    json << "}";
+  }
+  json << (first ? "}\n" : "\n  }\n");
+  json << "}\n";
+
+  std::string path = std::getenv("TRACE_REPORT");
+  if (path == "-") {
+    std::cerr << json.str();
+    return;
+  }
+  std::ofstream out(path);
+  if (!out.is_open()) {
+    std::cerr << "Cannot write run report to " << path << "\n";
+    return;
+  }
+  out << json.str();
+}
+
+void StageTimer::flush() {
+  if (totals_.rows == 0 && totals_.bytes == 0 && totals_.wholeNanos == 0) {
+    return;
+  }
+  if (RunReport *report = RunReport::current()) {
+    report->merge(stage_, totals_);
+  }
+  totals_ = StageTotals();
+}
+
+}  // namespace trace
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/log_linear_histogram.h"
+#include "common/perf_counters.h"
+
+namespace trace {
+
+// ----------------------------------------------------------------
+// Per-stage instrumentation.
+//
+// Set TRACE_REPORT=<path> (or "-" for stderr) and a tool writes a JSON
+// summary when it exits: rows, bytes, estimated time, throughput and a
+// latency histogram for each pipeline stage, and which stage took longest.
+// Without TRACE_REPORT the clock is never read.
+//
+//   trace::RunReport report("trace_info", argc, argv);   // in main()
+//   trace::StageTimer parse(trace::Stage::Parse);        // per thread/loop
+//   { auto timed = parse.time(line.size()); ...parse...; }
+//
+// StageTimer counts every call but reads the clock on one call in 2^shift
+// and scales up, so timing a ~100 ns step costs well under 1 ns per row.
+// With TRACE_PERF=1 the hardware counters of common/perf_counters.h are
+// read around the same scopes and reported per stage.
+// Each timer accumulates privately and merges into the report when it is
+// destroyed or flushed, so threads never share a cache line in the loop.
+// ----------------------------------------------------------------
+// Generate is the source stage of synthetic traces, in place of Read.
+enum class Stage { Generate, Read, Parse, Filter, Hash, Aggregate, Write };
+constexpr size_t NUM_STAGES = 7;
+
+const char *stageName(Stage stage);
+
+// Totals of one stage; what timers merge into the report.
+struct StageTotals {
+  uint64_t calls = 0;         // time() calls, timed or not
+  uint64_t rows = 0;
+  uint64_t bytes = 0;
+  uint64_t timedCalls = 0;    // time() calls that read the clock
+  uint64_t timedNanos = 0;    // their total duration
+  uint64_t wholeNanos = 0;    // from block(): work that was timed as a whole
+  LogLinearHistogram latencyNanos{3};  // of the timed calls
+  PerfValues timedCounters;   // hardware counters of the timed calls
+  PerfValues wholeCounters;   // and of the blocks
+
+  // Estimated time spent in the stage.
+  double seconds() const;
+  // Estimated count of `event` in the stage, scaled like seconds().
+  double counter(PerfEvent event) const;
+  void merge(const StageTotals &other);
+};
+
+class RunReport {
+ public:
+  // Starts the wall clock. The report is written by the destructor, so
+  // declare it first in main().
+  RunReport(std::string tool, int argc, char **argv);
+  ~RunReport();
+  RunReport(const RunReport &) = delete;
+  RunReport &operator=(const RunReport &) = delete;
+
+  // Whether TRACE_REPORT is set; read once.
+  static bool enabled();
+
+  // The report of this process, or nullptr outside a RunReport's lifetime.
+  static RunReport *current();
+
+  void merge(Stage stage, const StageTotals &totals);
+
+  // Extra top-level "name": value pairs, e.g. the input size.
+  void note(const std::string &name, double value);
+
+ private:
+  void write() const;
+
+  std::string tool_;
+  std::vector<std::string> args_;
+  std::chrono::steady_clock::time_point start_;
+  mutable std::mutex mutex_;
+  StageTotals stages_[NUM_STAGES];
+  std::vector<std::pair<std::string, double>> notes_;
+};
+
+class StageTimer {
+ public:
+  explicit StageTimer(Stage stage, unsigned sampleShift = 6)
+      : stage_(stage),
+        mask_((uint64_t{1} << sampleShift) - 1),
+        enabled_(RunReport::enabled()),
+        perf_(enabled_ ? PerfCounters::forThisThread() : nullptr) {}
+  ~StageTimer() { flush(); }
+  StageTimer(const StageTimer &) = delete;
+  StageTimer &operator=(const StageTimer &) = delete;
+
+  // Times the enclosing scope when it is this call's turn.
+  class Scope {
+   public:
+    Scope(StageTimer *timer, bool whole) : timer_(timer), whole_(whole) {
+      if (timer_ != nullptr) {
+        if (timer_->perf_ != nullptr) {
+          timer_->perf_->read(startCounters_);
+        }
+        start_ = std::chrono::steady_clock::now();
+      }
+    }
+    ~Scope() { stop(); }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+    // Ends the timed part before the end of the enclosing scope.
+    void stop() {
+      if (timer_ != nullptr) {
+        uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start_)
+                             .count();
+        StageTotals &totals = timer_->totals_;
+        if (timer_->perf_ != nullptr) {
+          PerfValues end;
+          timer_->perf_->read(end);
+          PerfValues &sum = whole_ ? totals.wholeCounters : totals.timedCounters;
+          for (size_t i = 0; i < NUM_PERF_EVENTS; ++i) {
+            sum.counts[i] += end.counts[i] - startCounters_.counts[i];
+          }
+        }
+        if (whole_) {
+          totals.wholeNanos += nanos;
+        } else {
+          totals.timedCalls++;
+          totals.timedNanos += nanos;
+          totals.latencyNanos.record(nanos);
+        }
+        timer_ = nullptr;
+      }
+    }
+
+   private:
+    StageTimer *timer_;
+    bool whole_;
+    std::chrono::steady_clock::time_point start_;
+    PerfValues startCounters_;
+  };
+
+  // One row of `bytes` bytes goes through the stage.
+  Scope time(uint64_t bytes = 0) {
+    totals_.rows++;
+    totals_.bytes += bytes;
+    return timeCall();
+  }
+
+  // Times one call without counting a row, for reads that may find none
+  // left; count(1, bytes) the row once the read succeeded.
+  Scope timeCall() {
+    return Scope(enabled_ && (totals_.calls++ & mask_) == 0 ? this : nullptr, false);
+  }
+
+  // Times the enclosing scope as a whole, for stages that work on blocks;
+  // count() what the block held.
+  Scope block() { return Scope(enabled_ ? this : nullptr, true); }
+
+  // Counts without timing, e.g. rows that a timed block handled.
+  void count(uint64_t rows, uint64_t bytes) {
+    totals_.rows += rows;
+    totals_.bytes += bytes;
+  }
+
+  // Merges what was counted so far into the report and starts over.
+  void flush();
+
+ private:
+  Stage stage_;
+  uint64_t mask_;
+  bool enabled_;
+  PerfCounters *perf_;
+  StageTotals totals_;
+};
+
+}  // namespace trace
@@ -0,0 +1,63 @@
+#include "common/space_saving.h"
+
+namespace trace {
+
+void SpaceSaving::merge(const SpaceSaving &other) {
+  if (other.total_ == 0 && other.floor_ == 0) {
+    return;
+  }
+  // An exact summary much smaller than this one is cheaper to replay as
+  // weighted updates than to merge, with the same guarantees.
+  if (other.floor_ == 0 && other.counters_.size() * 8 < capacity_) {
+    for (const Counter &c : other.counters_) {
+      add(c.keyHash, c.key, c.count);
+    }
+    return;
+  }
+  // Counts and errors add up; the side without the key adds its floor.
+  std::vector<Counter> merged;
+  merged.reserve(counters_.size() + other.counters_.size());
+  robin_hood::unordered_flat_map<uint64_t, uint32_t> at;
+  at.reserve(merged.capacity());
+  for (Counter &c : counters_) {
+    at[c.keyHash] = static_cast<uint32_t>(merged.size());
+    merged.push_back({std::move(c.key), c.keyHash, c.count + other.floor_, c.error + other.floor_});
+  }
+  for (const Counter &c : other.counters_) {
+    auto found = at.find(c.keyHash);
+    if (found != at.end()) {
+      Counter &m = merged[found->second];
+      m.count += c.count - other.floor_;
+      m.error += c.error - other.floor_;
+    } else {
+      merged.push_back({c.key, c.keyHash, c.count + floor_, c.error + floor_});
+    }
+  }
+  floor_ += other.floor_;
+  total_ += other.total_;
+
+  // Keep the largest counters; a dropped key may have had its count.
+  if (merged.size() > capacity_) {
+    std::nth_element(merged.begin(), merged.begin() + capacity_, merged.end(),
+                     [](const Counter &a, const Counter &b) { return a.count > b.count; });
+    for (size_t i = capacity_; i < merged.size(); ++i) {
+      floor_ = std::max(floor_, merged[i].count);
+    }
+    merged.resize(capacity_);
+  }
+
+  counters_ = std::move(merged);
+  index_.clear();
+  heap_.clear();
+  position_.clear();
+  for (uint32_t c = 0; c < counters_.size(); ++c) {
+    index_[counters_[c].keyHash] = c;
+    heap_.push_back(c);
+    position_.push_back(c);
+  }
+  for (size_t i = heap_.size() / 2; i-- > 0;) {
+    siftDown(i);
+  }
+}
+
+}  // namespace trace
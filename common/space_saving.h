@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "include/robin_hood/robin_hood.h"
+
+namespace trace {
+
+// ----------------------------------------------------------------
+// Space-Saving heavy hitters with weighted updates.
+//
+// At most `capacity` counters. A key without a counter takes over the
+// smallest one and inherits its count as its error, so for every key
+// reported count - error <= true weight <= count, and the error is at most
+// total / capacity. Any key heavier than that is guaranteed to hold a
+// counter. The counters sit in an indexed min-heap, so an update costs
+// one hash lookup and O(log capacity) moves at worst; keys are copied only
+// when they take over a counter.
+//
+// Summaries of disjoint parts of a stream merge into one with the same
+// guarantees (Agarwal et al., "Mergeable summaries"), so parts can be
+// summarized in parallel.
+// ----------------------------------------------------------------
+class SpaceSaving {
+ public:
+  struct Counter {
+    std::string key;
+    uint64_t keyHash = 0;
+    uint64_t count = 0;
+    uint64_t error = 0;
+  };
+
+  explicit SpaceSaving(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {}
+
+  void add(uint64_t keyHash, std::string_view key, uint64_t weight) {
+    total_ += weight;
+    auto found = index_.find(keyHash);
+    if (found != index_.end()) {
+      counters_[found->second].count += weight;
+      siftDown(position_[found->second]);
+      return;
+    }
+    if (counters_.size() < capacity_) {
+      uint32_t c = static_cast<uint32_t>(counters_.size());
+      // A key new to a merged summary may have had up to floor_ before.
+      counters_.push_back({std::string(key), keyHash, floor_ + weight, floor_});
+      index_[keyHash] = c;
+      heap_.push_back(c);
+      position_.push_back(static_cast<uint32_t>(heap_.size() - 1));
+      siftUp(heap_.size() - 1);
+      return;
+    }
+    uint32_t c = heap_[0];
+    Counter &smallest = counters_[c];
+    index_.erase(smallest.keyHash);
+    floor_ = smallest.count;
+    smallest.key.assign(key.data(), key.size());
+    smallest.keyHash = keyHash;
+    smallest.error = smallest.count;
+    smallest.count += weight;
+    index_[keyHash] = c;
+    siftDown(0);
+  }
+
+  // Adds the summary of a disjoint part of the stream. A key missing from
+  // one side may have had up to that side's maxError() there.
+  void merge(const SpaceSaving &other);
+
+  void clear() {
+    counters_.clear();
+    heap_.clear();
+    position_.clear();
+    index_.clear();
+    total_ = 0;
+    floor_ = 0;
+  }
+
+  uint64_t total() const { return total_; }
+
+  // Largest weight a key without a counter may have; every count - error
+  // is within this of the truth too.
+  uint64_t maxError() const { return floor_; }
+
+  // The n largest counters, largest first.
+  std::vector<Counter> top(size_t n) const {
+    std::vector<Counter> sorted = counters_;
+    n = std::min(n, sorted.size());
+    std::partial_sort(sorted.begin(), sorted.begin() + n, sorted.end(),
+                      [](const Counter &a, const Counter &b) { return a.count > b.count; });
+    sorted.resize(n);
+    return sorted;
+  }
+
+ private:
+  bool less(size_t a, size_t b) const {
+    return counters_[heap_[a]].count < counters_[heap_[b]].count;
+  }
+  void swapNodes(size_t a, size_t b) {
+    std::swap(heap_[a], heap_[b]);
+    position_[heap_[a]] = static_cast<uint32_t>(a);
+    position_[heap_[b]] = static_cast<uint32_t>(b);
+  }
+  void siftUp(size_t i) {
+    while (i > 0 && less(i, (i - 1) / 2)) {
+      swapNodes(i, (i - 1) / 2);
+      i = (i - 1) / 2;
+    }
+  }
+  void siftDown(size_t i) {
+    for (;;) {
+      size_t smallest = i;
+      size_t left = 2 * i + 1;
+      if (left < heap_.size() && less(left, smallest)) {
+        smallest = left;
+      }
+      if (left + 1 < heap_.size() && less(left + 1, smallest)) {
+        smallest = left + 1;
+      }
+      if (smallest == i) {
+        return;
+      }
+      swapNodes(i, smallest);
+      i = smallest;
+    }
+  }
+
+  size_t capacity_;
+  std::vector<Counter> counters_;
+  std::vector<uint32_t> heap_;      // counter indices, smallest count first
+  std::vector<uint32_t> position_;  // counter index -> heap slot
+  robin_hood::unordered_flat_map<uint64_t, uint32_t> index_;  // key hash -> counter
+  uint64_t total_ = 0;
+  uint64_t floor_ = 0;
+};
+
+}  // namespace trace
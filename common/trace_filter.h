@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace trace {
+
+// Object size (key + value) at or below which a request counts as
+// "Under 2KB" in trace_info and the tools that follow its classes.
+static const uint32_t TWO_KB = 2048;
+
+inline bool isUnderTwoKB(uint32_t objectSize) { return objectSize <= TWO_KB; }
+
+// Operations kept by preprocess_trace; everything else is dropped.
+inline bool isKeptOperation(std::string_view op) {
+  return op == "get" || op == "gets" || op == "delete";
+}
+
+inline bool isGetOperation(std::string_view op) {
+  return op == "get" || op == "gets";
+}
+
+// preprocess_trace's row filter: keep get/gets/delete, except reads of
+// empty values.
+inline bool keepRow(std::string_view op, uint32_t valueSize) {
+  if (!isKeptOperation(op)) {
+    return false;
+  }
+  return !(isGetOperation(op) && valueSize == 0);
+}
+
+}  // namespace trace
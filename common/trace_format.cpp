@@ -0,0 +1,39 @@
+#include "common/trace_format.h"
+
+#include <charconv>
+
+namespace trace {
+
+bool parseTraceFormat(const std::string &name, TraceFormat &format) {
+  if (name == "5col") {
+    format = TraceFormat::FiveColumn;
+    return true;
+  }
+  if (name == "7col") {
+    format = TraceFormat::SevenColumn;
+    return true;
+  }
+  return false;
+}
+
+bool parseDuration(const std::string &text, uint64_t &seconds) {
+  std::string_view number = text;
+  uint64_t scale = 1;
+  if (!number.empty()) {
+    switch (number.back()) {
+    case 's': scale = 1; number.remove_suffix(1); break;
+    case 'm': scale = 60; number.remove_suffix(1); break;
+    case 'h': scale = 3600; number.remove_suffix(1); break;
+    case 'd': scale = 86400; number.remove_suffix(1); break;
+    }
+  }
+  uint64_t value = 0;
+  auto result = std::from_chars(number.data(), number.data() + number.size(), value);
+  if (result.ec != std::errc() || result.ptr != number.data() + number.size() || value == 0) {
+    return false;
+  }
+  seconds = value * scale;
+  return true;
+}
+
+}  // namespace trace
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace trace {
+
+// The two CSV layouts the tools read.
+//
+//   FiveColumn  : key,op,size,op_count,key_size (with header line)
+//   SevenColumn : timestamp,key,key_size,value_size,client_id,op,TTL
+//                 (raw/merged trace, no header line)
+enum class TraceFormat { FiveColumn, SevenColumn };
+
+// Accepts "5col" and "7col"; leaves `format` alone otherwise.
+bool parseTraceFormat(const std::string &name, TraceFormat &format);
+
+// Trace time span such as "90", "90s", "15m", "1h" or "1d", in seconds
+// (the unit of the 7-column timestamp). False for anything else or 0.
+bool parseDuration(const std::string &text, uint64_t &seconds);
+
+inline bool hasHeader(TraceFormat format) {
+  return format == TraceFormat::FiveColumn;
+}
+
+inline size_t keyColumn(TraceFormat format) {
+  return format == TraceFormat::FiveColumn ? 0 : 1;
+}
+
+// Returns the `index`-th comma separated field of `line` without copying.
+// Returns an empty view if the line has fewer fields.
+inline std::string_view nthField(std::string_view line, size_t index) {
+  size_t begin = 0;
+  for (size_t i = 0; i < index; ++i) {
+    const void *comma =
+        std::memchr(line.data() + begin, ',', line.size() - begin);
+    if (comma == nullptr) {
+      return {};
+    }
+    begin = static_cast<const char *>(comma) - line.data() + 1;
+  }
+  const void *comma =
+      std::memchr(line.data() + begin, ',', line.size() - begin);
+  size_t end = comma == nullptr ? line.size()
+                                : static_cast<const char *>(comma) - line.data();
+  return line.substr(begin, end - begin);
+}
+
+// A 7-column key may contain commas. Its pieces are glued together without
+// the commas, as parseRawLine does; `buffer` holds the result then, and a
+// key without commas is returned as is.
+inline std::string_view joinKeyPieces(std::string_view key, std::string &buffer) {
+  if (std::memchr(key.data(), ',', key.size()) == nullptr) {
+    return key;
+  }
+  buffer.clear();
+  for (char c : key) {
+    if (c != ',') {
+      buffer.push_back(c);
+    }
+  }
+  return buffer;
+}
+
+// The key of `line`, the same string parseRecord yields. For 7col it is
+// everything between the timestamp and the last five fields; lines with
+// fewer fields fall back to the second one.
+inline std::string_view keyField(std::string_view line, TraceFormat format,
+                                 std::string &buffer) {
+  if (format == TraceFormat::FiveColumn) {
+    return nthField(line, 0);
+  }
+  size_t begin = line.find(',');
+  size_t end = line.size();
+  for (int i = 0; i < 5 && end != std::string_view::npos; ++i) {
+    end = end == 0 ? std::string_view::npos : line.rfind(',', end - 1);
+  }
+  if (begin == std::string_view::npos || end == std::string_view::npos || end <= begin) {
+    return nthField(line, 1);
+  }
+  return joinKeyPieces(line.substr(begin + 1, end - begin - 1), buffer);
+}
+
+}  // namespace trace
@@ -0,0 +1,324 @@
+#include "common/trace_generator.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+namespace trace {
+
+namespace {
+
+// Philox streams. Every row takes one 128-bit block of STREAM_ROW (and
+// STREAM_RANK only when the Zipf sampler rejects); every key takes one
+// 64-bit draw of STREAM_KEY that seeds the SplitMix64 sequence its
+// attributes come from.
+enum : uint64_t {
+  STREAM_ROW,   // row
+  STREAM_RANK,  // row * 256 + attempt
+  STREAM_KEY,   // rank
+};
+
+// SplitMix64 (Steele et al., OOPSLA'14): a cheap sequence of well mixed
+// words from one 64-bit seed.
+struct SplitMix64 {
+  uint64_t state;
+
+  uint64_t next() {
+    uint64_t z = (state += UINT64_C(0x9e3779b97f4a7c15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+  }
+  double uniform() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+};
+
+double uniform32(uint32_t word) { return static_cast<double>(word) * 0x1.0p-32; }
+
+const uint32_t MAX_KEY_SIZE = 250;  // memcached's limit
+
+std::vector<std::string> splitOn(const std::string &text, char sep) {
+  std::vector<std::string> parts;
+  size_t begin = 0;
+  while (true) {
+    size_t end = text.find(sep, begin);
+    parts.push_back(text.substr(begin, end == std::string::npos ? std::string::npos
+                                                                : end - begin));
+    if (end == std::string::npos) {
+      return parts;
+    }
+    begin = end + 1;
+  }
+}
+
+bool parseDouble(const std::string &text, double &value) {
+  char *end = nullptr;
+  value = std::strtod(text.c_str(), &end);
+  return !text.empty() && end == text.c_str() + text.size();
+}
+
+}  // namespace
+
+bool SizeMixture::parse(const std::string &text, std::string &error) {
+  components_.clear();
+  double total = 0;
+  for (const auto &part : splitOn(text, ',')) {
+    std::vector<std::string> fields = splitOn(part, ':');
+    Component c{Kind::Fixed, 0, 0, 1};
+    size_t params = 0;
+    if (fields[0] == "lognormal") {
+      c.kind = Kind::LogNormal;
+      params = 2;
+    } else if (fields[0] == "uniform") {
+      c.kind = Kind::Uniform;
+      params = 2;
+    } else if (fields[0] == "fixed") {
+      c.kind = Kind::Fixed;
+      params = 1;
+    } else {
+      error = "unknown size distribution '" + fields[0] + "'";
+      return false;
+    }
+    if (fields.size() != params + 1 && fields.size() != params + 2) {
+      error = "wrong number of parameters in '" + part + "'";
+      return false;
+    }
+    double weight = 1;
+    bool ok = parseDouble(fields[1], c.a) &&
+              (params < 2 || parseDouble(fields[2], c.b)) &&
+              (fields.size() == params + 1 || parseDouble(fields[params + 1], weight));
+    if (!ok || weight <= 0 || (c.kind == Kind::Uniform && c.b < c.a)) {
+      error = "bad parameters in '" + part + "'";
+      return false;
+    }
+    total += weight;
+    c.cumulativeWeight = total;
+    components_.push_back(c);
+  }
+  for (auto &c : components_) {
+    c.cumulativeWeight /= total;
+  }
+  return true;
+}
+
+uint32_t SizeMixture::sample(double u0, double u1, double u2) const {
+  size_t i = 0;
+  while (i + 1 < components_.size() && u0 >= components_[i].cumulativeWeight) {
+    i++;
+  }
+  const Component &c = components_[i];
+  double size = c.a;
+  switch (c.kind) {
+  case Kind::LogNormal: {
+    // Box-Muller; 1 - u1 is in (0, 1].
+    double normal = std::sqrt(-2.0 * std::log(1.0 - u1)) * std::cos(2.0 * M_PI * u2);
+    size = std::exp(c.a + c.b * normal);
+    break;
+  }
+  case Kind::Uniform:
+    size = c.a + std::floor(u1 * (c.b - c.a + 1));
+    break;
+  case Kind::Fixed:
+    break;
+  }
+  return static_cast<uint32_t>(std::min(std::max(size, 0.0), 4294967295.0));
+}
+
+bool WeightedChoice::parse(const std::string &text, std::string &error) {
+  names_.clear();
+  cumulativeWeights_.clear();
+  double total = 0;
+  for (const auto &part : splitOn(text, ',')) {
+    size_t eq = part.find('=');
+    double weight = 0;
+    if (eq == std::string::npos || eq == 0 || !parseDouble(part.substr(eq + 1), weight) ||
+        weight < 0) {
+      error = "expected name=weight, got '" + part + "'";
+      return false;
+    }
+    total += weight;
+    names_.push_back(part.substr(0, eq));
+    cumulativeWeights_.push_back(total);
+  }
+  if (total <= 0) {
+    error = "weights of '" + text + "' sum to zero";
+    return false;
+  }
+  for (auto &w : cumulativeWeights_) {
+    w /= total;
+  }
+  return true;
+}
+
+size_t WeightedChoice::pick(double u) const {
+  size_t i = 0;
+  while (i + 1 < cumulativeWeights_.size() && u >= cumulativeWeights_[i]) {
+    i++;
+  }
+  return i;
+}
+
+void setGeneratorDefaults(GeneratorConfig &config) {
+  std::string error;
+  config.keySize.parse("uniform:16:44", error);
+  config.valueSize.parse("lognormal:5.5:1.3:0.95,uniform:2049:100000:0.05", error);
+  config.ops.parse("get=0.75,gets=0.03,set=0.15,add=0.01,cas=0.01,delete=0.05", error);
+  config.ttls.parse("0=0.4,300=0.1,3600=0.3,86400=0.2", error);
+}
+
+TraceGenerator::TraceGenerator(const GeneratorConfig &config)
+    : config_(config), rng_(config.seed), zipf_(config.keys, config.alpha) {
+  for (size_t i = 0; i < config_.ttls.size(); ++i) {
+    ttlValues_.push_back(std::strtoull(config_.ttls.name(i).c_str(), nullptr, 10));
+  }
+  for (size_t i = 0; i < config_.ops.size(); ++i) {
+    opHasValue_.push_back(config_.ops.name(i) != "delete");
+  }
+  if (config_.clients == 0) {
+    config_.clients = 1;
+  }
+}
+
+uint32_t TraceGenerator::drawKey(uint64_t rank, char *chars, uint32_t &valueSize,
+                                 size_t &ttlIndex) const {
+  static const char ALPHABET[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+  // Everything here depends on the rank only, and is drawn in this order.
+  SplitMix64 key{rng_.bits(STREAM_KEY, rank)};
+  double u0 = key.uniform(), u1 = key.uniform(), u2 = key.uniform();
+  uint32_t keySize = config_.keySize.sample(u0, u1, u2);
+  keySize = std::min(std::max(keySize, 1u), MAX_KEY_SIZE);
+  uint32_t words = (keySize + 9) / 10;  // ten 6-bit characters per word
+  if (chars == nullptr) {
+    key.state += words * UINT64_C(0x9e3779b97f4a7c15);
+  } else {
+    for (uint32_t w = 0; w < words; ++w) {
+      uint64_t bits = key.next();
+      for (uint32_t i = w * 10; i < std::min(keySize, w * 10 + 10); ++i) {
+        chars[i] = ALPHABET[bits & 63];
+        bits >>= 6;
+      }
+    }
+  }
+  u0 = key.uniform(), u1 = key.uniform(), u2 = key.uniform();
+  valueSize = config_.valueSize.sample(u0, u1, u2);
+  ttlIndex = config_.ttls.pick(key.uniform());
+  return keySize;
+}
+
+bool TraceGenerator::cacheKeys(unsigned threads, uint64_t maxBytes) {
+  uint64_t keys = config_.keys;
+  if (keys > maxBytes / sizeof(CachedKey)) {
+    return false;
+  }
+  std::vector<CachedKey> cached(keys);
+  parallelFor(threads, [&](size_t t) {
+    for (uint64_t rank = keys * t / threads; rank < keys * (t + 1) / threads; ++rank) {
+      uint32_t valueSize = 0;
+      size_t ttlIndex = 0;
+      cached[rank].keySize = static_cast<uint8_t>(drawKey(rank, nullptr, valueSize, ttlIndex));
+      cached[rank].valueSize = valueSize;
+      cached[rank].ttlIndex = static_cast<uint8_t>(ttlIndex);
+    }
+  });
+  uint64_t offset = 0;
+  for (auto &entry : cached) {
+    entry.offset = offset;
+    offset += entry.keySize;
+  }
+  if (offset + keys * sizeof(CachedKey) > maxBytes || ttlValues_.size() > 256) {
+    return false;
+  }
+  std::string chars(offset, '\0');
+  parallelFor(threads, [&](size_t t) {
+    for (uint64_t rank = keys * t / threads; rank < keys * (t + 1) / threads; ++rank) {
+      uint32_t valueSize = 0;
+      size_t ttlIndex = 0;
+      drawKey(rank, &chars[cached[rank].offset], valueSize, ttlIndex);
+    }
+  });
+  cachedKeys_ = std::move(cached);
+  keyChars_ = std::move(chars);
+  return true;
+}
+
+void TraceGenerator::row(uint64_t index, GeneratedRow &out) const {
+  Philox4x32::Counter draw = rng_({static_cast<uint32_t>(index),
+                                   static_cast<uint32_t>(index >> 32),
+                                   static_cast<uint32_t>(STREAM_ROW), 0});
+  uint64_t attempt = 0;
+  uint64_t rank = zipf_([&]() {
+    if (attempt++ == 0) {
+      uint64_t bits = (static_cast<uint64_t>(draw[0]) << 32) | draw[1];
+      return static_cast<double>(bits >> 11) * 0x1.0p-53;
+    }
+    return rng_.uniform(STREAM_RANK, index * 256 + (attempt & 255));
+  });
+  size_t op = config_.ops.pick(uniform32(draw[2]));
+  out.op = &config_.ops.name(op);
+  out.clientId = (static_cast<uint64_t>(draw[3]) * config_.clients) >> 32;
+  out.timestamp = config_.startTime +
+                  static_cast<uint64_t>(static_cast<double>(index) / config_.rate);
+
+  uint32_t valueSize = 0;
+  size_t ttlIndex = 0;
+  if (!cachedKeys_.empty()) {
+    const CachedKey &cached = cachedKeys_[rank];
+    out.key.assign(keyChars_, cached.offset, cached.keySize);
+    out.keySize = cached.keySize;
+    valueSize = cached.valueSize;
+    ttlIndex = cached.ttlIndex;
+  } else {
+    out.key.resize(MAX_KEY_SIZE);
+    out.keySize = drawKey(rank, &out.key[0], valueSize, ttlIndex);
+    out.key.resize(out.keySize);
+  }
+  out.valueSize = opHasValue_[op] ? valueSize : 0;
+  out.ttl = ttlValues_[ttlIndex];
+}
+
+void TraceGenerator::appendRow(uint64_t index, TraceFormat format,
+                               GeneratedRow &scratch, std::string &out) const {
+  row(index, scratch);
+  // Formats straight into the output: room for the key, the longest op and
+  // five 20-digit numbers.
+  size_t start = out.size();
+  out.resize(start + scratch.key.size() + scratch.op->size() + 128);
+  char *p = &out[start];
+  char *end = &out[0] + out.size();
+  auto put = [&](std::string_view text) {
+    std::memcpy(p, text.data(), text.size());
+    p += text.size();
+  };
+  auto number = [&](uint64_t value) { p = std::to_chars(p, end, value).ptr; };
+  if (format == TraceFormat::SevenColumn) {
+    number(scratch.timestamp);
+    *p++ = ',';
+    put(scratch.key);
+    *p++ = ',';
+    number(scratch.keySize);
+    *p++ = ',';
+    number(scratch.valueSize);
+    *p++ = ',';
+    number(scratch.clientId);
+    *p++ = ',';
+    put(*scratch.op);
+    *p++ = ',';
+    number(scratch.ttl);
+  } else {
+    put(scratch.key);
+    *p++ = ',';
+    put(*scratch.op);
+    *p++ = ',';
+    number(static_cast<uint64_t>(scratch.keySize) + scratch.valueSize);
+    put(",1,");
+    number(scratch.keySize);
+  }
+  *p++ = '\n';
+  out.resize(p - out.data());
+}
+
+}  // namespace trace
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/line_scan.h"
+#include "common/philox.h"
+#include "common/trace_format.h"
+#include "common/zipf.h"
+
+namespace trace {
+
+// ----------------------------------------------------------------
+// Synthetic Twitter-like requests.
+//
+// Row i is a pure function of (seed, i): every random choice is a Philox
+// draw indexed by the row or by the key's popularity rank. Any thread can
+// produce any row, and the output does not depend on the thread count.
+// Per-key properties (key string, key size, value size, TTL) are drawn
+// from the rank, so every request of a key agrees on them.
+// ----------------------------------------------------------------
+
+// Mixture of size distributions, written as comma separated components
+//   lognormal:MU:SIGMA[:W]  exp(N(MU, SIGMA^2))
+//   uniform:LO:HI[:W]       integers in [LO, HI]
+//   fixed:V[:W]             always V
+// with relative weights W (default 1), e.g.
+// "lognormal:5.5:1.3:0.9,uniform:2049:100000:0.1".
+class SizeMixture {
+ public:
+  // Returns false and sets `error` for malformed text.
+  bool parse(const std::string &text, std::string &error);
+
+  // `u` are three independent uniforms in [0, 1).
+  uint32_t sample(double u0, double u1, double u2) const;
+
+ private:
+  enum class Kind { LogNormal, Uniform, Fixed };
+  struct Component {
+    Kind kind;
+    double a;
+    double b;
+    double cumulativeWeight;
+  };
+  std::vector<Component> components_;
+};
+
+// Weighted choice among named values, written "name=W,name=W,...", e.g.
+// "get=0.8,set=0.15,delete=0.05" or, for TTLs, "0=0.5,3600=0.5".
+class WeightedChoice {
+ public:
+  bool parse(const std::string &text, std::string &error);
+
+  size_t size() const { return names_.size(); }
+  const std::string &name(size_t i) const { return names_[i]; }
+  size_t pick(double u) const;
+
+ private:
+  std::vector<std::string> names_;
+  std::vector<double> cumulativeWeights_;
+};
+
+struct GeneratorConfig {
+  uint64_t rows = 1000000;
+  uint64_t keys = 100000;
+  double alpha = 0.99;  // Zipf skew of key popularity
+  uint64_t seed = 0;
+  SizeMixture keySize;
+  SizeMixture valueSize;
+  WeightedChoice ops;
+  WeightedChoice ttls;
+  double rate = 100000;  // requests per second of trace time
+  uint64_t startTime = 0;
+  uint64_t clients = 1000;  // below 2^32
+};
+
+// Fills `config` with Twitter-like defaults for the size, op and TTL mixes.
+void setGeneratorDefaults(GeneratorConfig &config);
+
+struct GeneratedRow {
+  uint64_t timestamp = 0;
+  std::string key;
+  uint32_t keySize = 0;
+  uint32_t valueSize = 0;  // 0 for deletes
+  uint64_t clientId = 0;
+  const std::string *op = nullptr;
+  uint64_t ttl = 0;
+};
+
+class TraceGenerator {
+ public:
+  explicit TraceGenerator(const GeneratorConfig &config);
+
+  // Precomputes every key string and its sizes and TTL on `threads`
+  // threads, if they fit in `maxBytes`; rows then copy them instead of
+  // drawing them again. Returns whether the cache was built. The output is
+  // the same either way.
+  bool cacheKeys(unsigned threads, uint64_t maxBytes);
+
+  // Row `index` of the trace.
+  void row(uint64_t index, GeneratedRow &out) const;
+
+  // Appends row `index` and its '\n' to `out` in the given layout.
+  void appendRow(uint64_t index, TraceFormat format, GeneratedRow &scratch,
+                 std::string &out) const;
+
+  const GeneratorConfig &config() const { return config_; }
+
+ private:
+  struct CachedKey {
+    uint64_t offset;     // into keyChars_
+    uint32_t valueSize;
+    uint8_t keySize;     // at most 250
+    uint8_t ttlIndex;
+  };
+
+  // Draws the key of popularity rank `rank`: writes its characters to
+  // `chars` (skipped when null) and returns its key size.
+  uint32_t drawKey(uint64_t rank, char *chars, uint32_t &valueSize,
+                   size_t &ttlIndex) const;
+
+  GeneratorConfig config_;
+  Philox4x32 rng_;
+  ZipfDistribution zipf_;
+  std::vector<uint64_t> ttlValues_;
+  std::vector<bool> opHasValue_;
+  std::vector<CachedKey> cachedKeys_;
+  std::string keyChars_;
+};
+
+// Header line of the 5-column layout.
+inline const char *fiveColumnHeader() { return "key,op,size,op_count,key_size\n"; }
+
+}  // namespace trace
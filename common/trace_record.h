@@ -0,0 +1,95 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "common/trace_format.h"
+
+namespace trace {
+
+// One parsed request. Views point into the input line, except a 7-column
+// key that had commas, which points at `keyBuffer`. Fields that the
+// 5-column layout does not have (timestamp, client_id, TTL) stay 0.
+struct TraceRecord {
+  uint64_t timestamp = 0;
+  std::string_view key;
+  std::string keyBuffer;
+  std::string_view op;
+  uint32_t keySize = 0;
+  uint32_t valueSize = 0;
+  uint32_t objectSize = 0;  // key + value, the "size" column of 5col
+  uint64_t clientId = 0;
+  uint64_t ttl = 0;
+};
+
+// Splits off the next comma separated field of `rest`.
+inline std::string_view nextField(std::string_view &rest) {
+  size_t comma = rest.find(',');
+  std::string_view field = rest.substr(0, comma);
+  rest = comma == std::string_view::npos ? std::string_view()
+                                         : rest.substr(comma + 1);
+  return field;
+}
+
+// Splits off the last comma separated field of `rest`. False when `rest`
+// has no comma, i.e. there is no field left in front of it.
+inline bool lastField(std::string_view &rest, std::string_view &field) {
+  size_t comma = rest.rfind(',');
+  if (comma == std::string_view::npos) {
+    return false;
+  }
+  field = rest.substr(comma + 1);
+  rest = rest.substr(0, comma);
+  return true;
+}
+
+template <typename T>
+inline bool parseNumber(std::string_view field, T &value) {
+  if (!field.empty() && field.back() == '\r') {
+    field.remove_suffix(1);
+  }
+  auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+  return result.ec == std::errc() && result.ptr == field.data() + field.size();
+}
+
+// Parses one line without allocating (but for the first 7-column keys with
+// commas). Returns false for malformed rows.
+inline bool parseRecord(std::string_view line, TraceFormat format,
+                        TraceRecord &rec) {
+  if (!line.empty() && line.back() == '\n') {
+    line.remove_suffix(1);
+  }
+  std::string_view rest = line;
+  if (format == TraceFormat::FiveColumn) {
+    // key,op,size,op_count,key_size
+    uint32_t opCount = 0;
+    rec.key = nextField(rest);
+    rec.op = nextField(rest);
+    if (!parseNumber(nextField(rest), rec.objectSize) ||
+        !parseNumber(nextField(rest), opCount) ||
+        !parseNumber(nextField(rest), rec.keySize)) {
+      return false;
+    }
+    rec.valueSize = rec.objectSize - rec.keySize;
+    return true;
+  }
+  // timestamp,key,key_size,value_size,client_id,op,TTL. Keys may contain
+  // commas, so the fields after the key are taken from the right.
+  if (!parseNumber(nextField(rest), rec.timestamp)) {
+    return false;
+  }
+  std::string_view keySize, valueSize, clientId, ttl;
+  if (!lastField(rest, ttl) || !lastField(rest, rec.op) || !lastField(rest, clientId) ||
+      !lastField(rest, valueSize) || !lastField(rest, keySize) ||
+      !parseNumber(keySize, rec.keySize) || !parseNumber(valueSize, rec.valueSize) ||
+      !parseNumber(clientId, rec.clientId) || !parseNumber(ttl, rec.ttl)) {
+    return false;
+  }
+  rec.key = joinKeyPieces(rest, rec.keyBuffer);
+  rec.objectSize = rec.keySize + rec.valueSize;
+  return true;
+}
+
+}  // namespace trace
@@ -0,0 +1,83 @@
+#include "common/trace_stats.h"
+
+#include <iomanip>
+
+namespace trace {
+
+namespace {
+
+void computeQuantiles(const LogLinearHistogram &hist, uint64_t (&quantiles)[NUM_QUANTILES]) {
+    for (int i = 0; i < NUM_QUANTILES; ++i) {
+        quantiles[i] = hist.valueAtQuantile(QUANTILES[i]);
+    }
+}
+
+void printQuantiles(std::ostream &out, const char *label, const uint64_t (&quantiles)[NUM_QUANTILES]) {
+    out << label;
+    for (int i = 0; i < NUM_QUANTILES; ++i) {
+        out << (i == 0 ? "" : ", ") << QUANTILE_NAMES[i] << " " << quantiles[i];
+    }
+    out << "\n";
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------
+// StatsAccumulator => Stats
+// ----------------------------------------------------------------
+Stats computeStats(const StatsAccumulator &acc)
+{
+    Stats s;
+    if (acc.lineCount == 0) {
+        return s;
+    }
+    
+    s.avgKeySize    = static_cast<double>(acc.totalKeySize)    / acc.lineCount;
+    s.avgValueSize  = static_cast<double>(acc.totalValueSize)  / acc.lineCount;
+    s.avgObjectSize = static_cast<double>(acc.totalObjectSize) / acc.lineCount;
+    s.sumObjectSize = acc.totalObjectSize;
+    
+    uint64_t sumKeyAverages = 0;
+    for (const auto &kv : acc.mapKeyAgg) {
+        const auto &agg = kv.second;
+        if (agg.count > 0) {
+            sumKeyAverages += (agg.sumObjectSize / agg.count);
+        }
+    }
+    s.sumKeyBasedAvg = sumKeyAverages;
+    s.uniqueKeyCount = acc.mapKeyAgg.size();
+    s.totalKeyCount  = acc.lineCount;
+    s.lineCount      = acc.lineCount;
+    
+    computeQuantiles(acc.keySizes,    s.keySizeQuantiles);
+    computeQuantiles(acc.valueSizes,  s.valueSizeQuantiles);
+    computeQuantiles(acc.objectSizes, s.objectSizeQuantiles);
+    computeQuantiles(acc.ttls,        s.ttlQuantiles);
+    s.ttlCount = acc.ttls.total();
+    
+    return s;
+}
+
+// ----------------------------------------------------------------
+// Print stats; quantiles are bucket upper bounds, at most 0.8% above the
+// exact value
+// ----------------------------------------------------------------
+void printStats(std::ostream &out, const Stats &st, const std::string &title) {
+    out << "=== " << title << " ===\n";
+    out << "  Average key size     : " << std::fixed << std::setprecision(2) << st.avgKeySize << "\n";
+    out << "  Average value size   : " << std::fixed << std::setprecision(2) << st.avgValueSize << "\n";
+    out << "  Average object size  : " << std::fixed << std::setprecision(2) << st.avgObjectSize << "\n";
+    printQuantiles(out, "  Key size quantiles    : ", st.keySizeQuantiles);
+    printQuantiles(out, "  Value size quantiles  : ", st.valueSizeQuantiles);
+    printQuantiles(out, "  Object size quantiles : ", st.objectSizeQuantiles);
+    if (st.ttlCount > 0) {
+        printQuantiles(out, "  TTL quantiles         : ", st.ttlQuantiles);
+    }
+    out << "  Footprint1 (sum of object size)               : " << st.sumObjectSize << "\n";
+    out << "  Footprint2 (sum of average of duplicated key) : " << st.sumKeyBasedAvg << "\n";
+    out << "  Unique key count     : " << st.uniqueKeyCount << "\n";
+    out << "  Total key count      : " << st.totalKeyCount  << "\n";
+    out << "  Total line count     : " << st.lineCount      << "\n\n";
+}
+
+}  // namespace trace
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "include/robin_hood/robin_hood.h"
+#include "common/log_linear_histogram.h"
+
+namespace trace {
+
+// Per-class request statistics trace_info reports (All / Under 2KB /
+// Over 2KB).
+struct KeyAgg {
+    uint64_t sumObjectSize = 0;
+    uint64_t count = 0;
+};
+
+// Quantiles printStats reports, and their names.
+constexpr int NUM_QUANTILES = 4;
+constexpr double QUANTILES[NUM_QUANTILES] = {0.5, 0.9, 0.99, 0.999};
+constexpr const char *QUANTILE_NAMES[NUM_QUANTILES] = {"p50", "p90", "p99", "p99.9"};
+
+// Size and TTL distributions are kept in log-linear histograms with 2^7
+// bins per power of two: a DDSketch-style relative error of at most 0.8%,
+// a fixed ~60KB each however long the trace is, one lzcnt per update, and
+// merging is adding the counts.
+constexpr unsigned QUANTILE_SUB_BUCKET_BITS = 7;
+
+struct StatsAccumulator {
+    uint64_t totalKeySize = 0;
+    uint64_t totalValueSize = 0;
+    uint64_t totalObjectSize = 0;
+    uint64_t lineCount = 0;
+    
+    LogLinearHistogram keySizes{QUANTILE_SUB_BUCKET_BITS};
+    LogLinearHistogram valueSizes{QUANTILE_SUB_BUCKET_BITS};
+    LogLinearHistogram objectSizes{QUANTILE_SUB_BUCKET_BITS};
+    LogLinearHistogram ttls{QUANTILE_SUB_BUCKET_BITS};  // 7-column traces only
+    
+    robin_hood::unordered_map<std::string, KeyAgg> mapKeyAgg;
+};
+
+struct Stats {
+    double avgKeySize = 0.0;
+    double avgValueSize = 0.0;
+    double avgObjectSize = 0.0;
+    uint64_t sumObjectSize = 0;
+    uint64_t sumKeyBasedAvg = 0;
+    uint64_t uniqueKeyCount = 0;
+    uint64_t totalKeyCount = 0;
+    uint64_t lineCount = 0;
+    
+    uint64_t keySizeQuantiles[NUM_QUANTILES] = {};
+    uint64_t valueSizeQuantiles[NUM_QUANTILES] = {};
+    uint64_t objectSizeQuantiles[NUM_QUANTILES] = {};
+    uint64_t ttlQuantiles[NUM_QUANTILES] = {};
+    uint64_t ttlCount = 0;
+};
+
+// ----------------------------------------------------------------
+// Read oneline and update
+// ----------------------------------------------------------------
+inline void updateStats(StatsAccumulator &acc, 
+                        const std::string &key, 
+                        uint32_t keySize, 
+                        uint32_t valueSize, 
+                        uint32_t objectSize) 
+{
+    acc.totalKeySize    += keySize;
+    acc.totalValueSize  += valueSize;
+    acc.totalObjectSize += objectSize;
+    acc.lineCount++;
+    acc.keySizes.record(keySize);
+    acc.valueSizes.record(valueSize);
+    acc.objectSizes.record(objectSize);
+    
+    auto &agg = acc.mapKeyAgg[key];
+    agg.sumObjectSize += objectSize;
+    agg.count++;
+}
+
+// The TTL column of a 7-column row.
+inline void updateTtl(StatsAccumulator &acc, uint64_t ttl) {
+    acc.ttls.record(ttl);
+}
+
+// ----------------------------------------------------------------
+// StatsAccumulator => Stats, and the report format
+// ----------------------------------------------------------------
+Stats computeStats(const StatsAccumulator &acc);
+void printStats(std::ostream &out, const Stats &st, const std::string &title);
+
+}  // namespace trace
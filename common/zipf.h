@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace trace {
+
+// Zipf distribution over ranks [0, n): rank k is drawn with probability
+// proportional to (k + 1)^-alpha, alpha >= 0.
+//
+// Rejection-inversion sampling (Hörmann and Derflinger, "Rejection-inversion
+// to generate variates from monotone discrete distributions", 1996): O(1)
+// memory and time per draw for any n, with fewer than ~1.1 uniforms per
+// draw on average. The caller supplies the uniforms, so a counter-based
+// generator keeps the draws reproducible across threads.
+class ZipfDistribution {
+ public:
+  ZipfDistribution(uint64_t n, double alpha)
+      : n_(n == 0 ? 1 : n), alpha_(alpha) {
+    hIntegralX1_ = hIntegral(1.5) - 1.0;
+    hIntegralN_ = hIntegral(static_cast<double>(n_) + 0.5);
+    s_ = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+  }
+
+  uint64_t size() const { return n_; }
+  double alpha() const { return alpha_; }
+
+  // `uniform()` must return doubles in [0, 1).
+  template <typename Uniform>
+  uint64_t operator()(Uniform &&uniform) const {
+    while (true) {
+      double u = hIntegralN_ + uniform() * (hIntegralX1_ - hIntegralN_);
+      double x = hIntegralInverse(u);
+      double k = std::floor(x + 0.5);
+      if (k < 1.0) {
+        k = 1.0;
+      } else if (k > static_cast<double>(n_)) {
+        k = static_cast<double>(n_);
+      }
+      if (k - x <= s_ || u >= hIntegral(k + 0.5) - h(k)) {
+        return static_cast<uint64_t>(k) - 1;
+      }
+    }
+  }
+
+ private:
+  double h(double x) const { return std::exp(-alpha_ * std::log(x)); }
+
+  double hIntegral(double x) const {
+    double logX = std::log(x);
+    return helper2((1.0 - alpha_) * logX) * logX;
+  }
+
+  double hIntegralInverse(double x) const {
+    double t = x * (1.0 - alpha_);
+    if (t < -1.0) {
+      t = -1.0;  // Rounding near the end of the support.
+    }
+    return std::exp(helper1(t) * x);
+  }
+
+  // log1p(x) / x and expm1(x) / x, with their series near 0 so alpha = 1
+  // needs no special case.
+  static double helper1(double x) {
+    return std::abs(x) > 1e-8 ? std::log1p(x) / x
+                              : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+  }
+  static double helper2(double x) {
+    return std::abs(x) > 1e-8
+               ? std::expm1(x) / x
+               : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+  }
+
+  uint64_t n_;
+  double alpha_;
+  double hIntegralX1_;
+  double hIntegralN_;
+  double s_;
+};
+
+}  // namespace trace
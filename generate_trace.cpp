@@ -0,0 +1,176 @@
+#include "include/argparse/argparse.hpp"
+#include "include/fmt/core.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/line_scan.h"
+#include "common/run_report.h"
+#include "common/trace_format.h"
+#include "common/trace_generator.h"
+
+// Rows each worker formats per round. A round is `threads` chunks; the
+// previous round is written while the next one is generated.
+static const uint64_t CHUNK_ROWS = 1 << 16;
+
+void writeRound(std::ofstream &out, const std::vector<std::string> &chunks) {
+  trace::StageTimer write(trace::Stage::Write);
+  auto timed = write.block();
+  for (const auto &chunk : chunks) {
+    out.write(chunk.data(), chunk.size());
+    write.count(0, chunk.size());
+  }
+}
+
+int main(int argc, char **argv) {
+  trace::RunReport report("generate_trace", argc, argv);
+  argparse::ArgumentParser options("generate_trace");
+
+  options.add_argument("output")
+      .help("Trace file to write");
+  options.add_argument("-n", "--rows")
+      .default_value(uint64_t{1000000})
+      .scan<'u', uint64_t>()
+      .help("Requests to generate");
+  options.add_argument("-k", "--keys")
+      .default_value(uint64_t{100000})
+      .scan<'u', uint64_t>()
+      .help("Distinct keys");
+  options.add_argument("-a", "--alpha")
+      .default_value(0.99)
+      .scan<'g', double>()
+      .help("Zipf skew of key popularity (0 = uniform)");
+  options.add_argument("-s", "--seed")
+      .default_value(uint64_t{0})
+      .scan<'u', uint64_t>()
+      .help("Equal seeds and options give identical traces");
+  options.add_argument("--key-size")
+      .default_value(std::string("uniform:16:44"))
+      .help("Key size mixture, e.g. 'uniform:16:44' (see README)");
+  options.add_argument("--value-size")
+      .default_value(std::string("lognormal:5.5:1.3:0.95,uniform:2049:100000:0.05"))
+      .help("Value size mixture of lognormal:MU:SIGMA[:W], uniform:LO:HI[:W] "
+            "and fixed:V[:W] components");
+  options.add_argument("--ops")
+      .default_value(std::string("get=0.75,gets=0.03,set=0.15,add=0.01,cas=0.01,delete=0.05"))
+      .help("Operation mix as op=weight pairs");
+  options.add_argument("--ttl")
+      .default_value(std::string("0=0.4,300=0.1,3600=0.3,86400=0.2"))
+      .help("Per-key TTL mix as ttl=weight pairs");
+  options.add_argument("--rate")
+      .default_value(100000.0)
+      .scan<'g', double>()
+      .help("Requests per second of trace time; sets the timestamps");
+  options.add_argument("--start-time")
+      .default_value(uint64_t{0})
+      .scan<'u', uint64_t>()
+      .help("Timestamp of the first request");
+  options.add_argument("--clients")
+      .default_value(uint64_t{1000})
+      .scan<'u', uint64_t>()
+      .help("Distinct client ids, drawn uniformly per request");
+  options.add_argument("--key-cache-mb")
+      .default_value(uint64_t{1024})
+      .scan<'u', uint64_t>()
+      .help("Precompute the keys when they fit in this many MB (0 = never); "
+            "faster, same output");
+  options.add_argument("-f", "--format")
+      .default_value(std::string("7col"))
+      .choices("5col", "7col")
+      .help("7col: raw trace layout; 5col: key,op,size,op_count,key_size with header");
+  options.add_argument("-t", "--threads")
+      .default_value(std::max(1u, std::thread::hardware_concurrency()))
+      .scan<'u', unsigned>()
+      .help("Worker threads; the output does not depend on this");
+
+  try {
+    options.parse_args(argc, argv);
+  } catch (const std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << options;
+    return 1;
+  }
+
+  trace::GeneratorConfig config;
+  config.rows = options.get<uint64_t>("--rows");
+  config.keys = options.get<uint64_t>("--keys");
+  config.alpha = options.get<double>("--alpha");
+  config.seed = options.get<uint64_t>("--seed");
+  config.rate = options.get<double>("--rate");
+  config.startTime = options.get<uint64_t>("--start-time");
+  config.clients = options.get<uint64_t>("--clients");
+  std::string error;
+  if (!config.keySize.parse(options.get<std::string>("--key-size"), error) ||
+      !config.valueSize.parse(options.get<std::string>("--value-size"), error) ||
+      !config.ops.parse(options.get<std::string>("--ops"), error) ||
+      !config.ttls.parse(options.get<std::string>("--ttl"), error)) {
+    std::cerr << "Error: " << error << std::endl;
+    return 1;
+  }
+  if (config.keys == 0 || config.alpha < 0 || config.rate <= 0) {
+    std::cerr << "Error: --keys and --rate must be positive and --alpha non-negative."
+              << std::endl;
+    return 1;
+  }
+  trace::TraceFormat format = trace::TraceFormat::SevenColumn;
+  trace::parseTraceFormat(options.get<std::string>("--format"), format);
+  unsigned threads = std::max(1u, options.get<unsigned>("--threads"));
+
+  auto outputFile = options.get<std::string>("output");
+  std::ofstream out(outputFile, std::ios::binary);
+  if (!out.is_open()) {
+    std::cerr << "Error: Unable to open output file " << outputFile << std::endl;
+    return 1;
+  }
+  if (trace::hasHeader(format)) {
+    out << trace::fiveColumnHeader();
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  trace::TraceGenerator generator(config);
+  generator.cacheKeys(threads, options.get<uint64_t>("--key-cache-mb") << 20);
+  std::vector<std::string> chunks[2] = {std::vector<std::string>(threads),
+                                        std::vector<std::string>(threads)};
+  std::vector<trace::GeneratedRow> scratch(threads);
+  std::thread writer;
+  uint64_t bytes = 0;
+  int current = 0;
+  for (uint64_t roundStart = 0; roundStart < config.rows;
+       roundStart += CHUNK_ROWS * threads) {
+    trace::parallelFor(threads, [&](size_t t) {
+      std::string &chunk = chunks[current][t];
+      chunk.clear();
+      uint64_t begin = std::min(config.rows, roundStart + t * CHUNK_ROWS);
+      uint64_t end = std::min(config.rows, begin + CHUNK_ROWS);
+      trace::StageTimer generate(trace::Stage::Generate);
+      auto timed = generate.block();
+      for (uint64_t i = begin; i < end; ++i) {
+        generator.appendRow(i, format, scratch[t], chunk);
+      }
+      generate.count(end - begin, chunk.size());
+    });
+    for (const auto &chunk : chunks[current]) {
+      bytes += chunk.size();
+    }
+    if (writer.joinable()) {
+      writer.join();
+    }
+    writer = std::thread(writeRound, std::ref(out), std::cref(chunks[current]));
+    current ^= 1;
+  }
+  if (writer.joinable()) {
+    writer.join();
+  }
+  out.close();
+
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = end - start;
+  std::cout << fmt::format("Generated {} rows ({:.2f} GB) to {} in {:.2f} s ({:.2f} GB/s)",
+                           config.rows, bytes / 1e9, outputFile, elapsed.count(),
+                           bytes / 1e9 / elapsed.count())
+            << std::endl;
+  return 0;
+}
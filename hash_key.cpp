@@ -2,19 +2,13 @@
 #include <fstream>
 #include <string>
 #include "csv.h"       
-#include "md5.h"       
-
-std::string md5Truncate(const std::string& input, size_t length = 16) {
-    Chocobo1::MD5 md5;
-    md5.addData(input.data(), input.size()).finalize();
-    std::string hashHex = md5.toString(); 
-    if (hashHex.size() > length) {
-        return hashHex.substr(0, length);
-    }
-    return hashHex;
-}
+#include "common/csv_source.h"
+#include "common/md5_truncate.h"
+#include "common/progress.h"
+#include "common/run_report.h"
 
 int main(int argc, char* argv[]) {
+    trace::RunReport report("hash_key", argc, argv);
     if (argc < 3) {
         std::cerr << "Usage: " << argv[0] << " <input_csv> <output_csv>\n";
         return 1;
@@ -23,7 +17,9 @@ int main(int argc, char* argv[]) {
     const std::string inputCsv = argv[1];
     const std::string outputCsv = argv[2];
 
-    io::CSVReader<5> in(inputCsv);
+    trace::ProgressReporter progress("hash_key", trace::fileBytes({inputCsv}));
+    trace::ProgressReporter::Batch counted(progress);
+    io::CSVReader<5> in(inputCsv, trace::countedFile(inputCsv, progress));
     in.read_header(io::ignore_extra_column, 
                    "key", "op", "size", "op_count", "key_size");
 
@@ -37,13 +33,24 @@ int main(int argc, char* argv[]) {
 
     std::string key, op;
     int size, op_count, key_size;
-    size_t lineCount = 0;
-    while (in.read_row(key, op, size, op_count, key_size)) {
-        std::string newKey = md5Truncate(key, 16);
-	if(lineCount%100000000){
-            std::cout << "processed line: " << lineCount << " remaining line: " << 61700000000-lineCount << "\n";
+    trace::StageTimer parse(trace::Stage::Parse);
+    trace::StageTimer hash(trace::Stage::Hash);
+    trace::StageTimer write(trace::Stage::Write);
+    while (true) {
+        {
+            auto timed = parse.timeCall();
+            if (!in.read_row(key, op, size, op_count, key_size)) {
+                break;
+            }
+        }
+        parse.count(1, 0);
+        std::string newKey;
+        {
+            auto timed = hash.time(key.size());
+            newKey = trace::md5Truncate(key, 16);
         }
-	lineCount++;
+        counted.add(1, 0);
+        auto timed = write.time();
 	out << newKey << "," 
             << op << "," 
             << size << "," 
@@ -52,6 +59,7 @@ int main(int argc, char* argv[]) {
             << "\n";
     }
 
+    write.count(0, static_cast<uint64_t>(out.tellp()));
     out.close();
     std::cout << "Done! Created file: " << outputCsv << std::endl;
 
@@ -0,0 +1,280 @@
+#include "include/argparse/argparse.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "include/robin_hood/robin_hood.h"
+#include "common/key_hash.h"
+#include "common/line_scan.h"
+#include "common/log_linear_histogram.h"
+#include "common/mapped_file.h"
+#include "common/progress.h"
+#include "common/run_report.h"
+#include "common/trace_filter.h"
+#include "common/trace_format.h"
+#include "common/trace_record.h"
+
+enum SizeClass { ALL, UNDER_2KB, OVER_2KB, NUM_CLASSES };
+const char *const CLASS_NAMES[NUM_CLASSES] = {"All", "Under 2KB", "Over 2KB"};
+
+// Table bytes per tracked key: 16-byte entries at robin_hood's maximum load
+// of 80%, plus the info byte and slack for the next doubling.
+const uint64_t BYTES_PER_KEY = 32;
+
+// Key hash -> time of its latest request.
+using LastSeen = robin_hood::unordered_flat_map<uint64_t, uint64_t>;
+
+// A request that passed the sampling limit, in input order.
+struct SampledRequest {
+  uint64_t keyHash;
+  uint64_t timestamp;
+  uint32_t size;
+};
+
+// Per-worker share of one window of the input.
+struct WindowPart {
+  std::vector<SampledRequest> sampled;
+  uint64_t requests[NUM_CLASSES] = {};
+  uint64_t badLines = 0;
+};
+
+// Time between successive requests of a key, over the keys hashed at or
+// below `limit`. When the table outgrows `maxKeys` the limit drops so that
+// a tenth of it is freed, and later intervals count for 1/rate each
+// (adaptive SHARDS), so memory stays within the budget.
+class InterReference {
+ public:
+  InterReference(uint64_t limit, uint64_t maxKeys, unsigned subBucketBits)
+      : limit_(limit), maxKeys_(maxKeys) {
+    for (int c = 0; c < NUM_CLASSES; ++c) {
+      intervals_.emplace_back(subBucketBits);
+    }
+  }
+
+  uint64_t limit() const { return limit_; }
+  const LastSeen &table() const { return lastSeen_; }
+  const trace::WeightedHistogram &intervals(int c) const { return intervals_[c]; }
+  double firstReferences(int c) const { return first_[c]; }
+
+  void access(uint64_t keyHash, uint64_t time, uint32_t size) {
+    if (keyHash > limit_) {
+      return;
+    }
+    double weight = 1.0 / trace::hashLimitRate(limit_);
+    int c = trace::isUnderTwoKB(size) ? UNDER_2KB : OVER_2KB;
+    auto inserted = lastSeen_.try_emplace(keyHash, time);
+    if (inserted.second) {
+      first_[ALL] += weight;
+      first_[c] += weight;
+      if (maxKeys_ > 0 && lastSeen_.size() > maxKeys_) {
+        shrink();
+      }
+      return;
+    }
+    uint64_t &last = inserted.first->second;
+    // A row earlier than the key's previous one counts as 0.
+    uint64_t interval = time > last ? time - last : 0;
+    intervals_[ALL].record(interval, weight);
+    intervals_[c].record(interval, weight);
+    last = std::max(last, time);
+  }
+
+ private:
+  // Lowers the limit to the hash below which 90% of the tracked keys lie
+  // and drops the keys above it.
+  void shrink() {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(lastSeen_.size());
+    for (const auto &kv : lastSeen_) {
+      hashes.push_back(kv.first);
+    }
+    auto keep = hashes.begin() + maxKeys_ * 9 / 10;
+    std::nth_element(hashes.begin(), keep, hashes.end());
+    limit_ = *keep;
+    LastSeen kept;
+    kept.reserve(maxKeys_);
+    for (const auto &kv : lastSeen_) {
+      if (kv.first <= limit_) {
+        kept.insert(kv);
+      }
+    }
+    lastSeen_.swap(kept);
+  }
+
+  uint64_t limit_;
+  uint64_t maxKeys_;
+  LastSeen lastSeen_;
+  std::vector<trace::WeightedHistogram> intervals_;
+  double first_[NUM_CLASSES] = {};
+};
+
+void printIntervals(std::ostream &out, const InterReference &irt, int c, uint64_t requests,
+                    const char *unit) {
+  const trace::WeightedHistogram &hist = irt.intervals(c);
+  double total = hist.total();
+  out << "=== Inter-reference time: " << CLASS_NAMES[c] << " ===\n";
+  out << "# requests " << requests << " first_references "
+      << std::llround(irt.firstReferences(c)) << " intervals " << std::llround(total)
+      << " unit " << unit << "\n";
+  out << "# lower upper count fraction cumulative\n";
+  double seen = 0;
+  for (size_t i = 0; i < hist.bins.numBuckets(); ++i) {
+    if (hist.counts[i] == 0) {
+      continue;
+    }
+    seen += hist.counts[i];
+    out << hist.bins.lowerBound(i) << " " << hist.bins.upperBound(i) << " "
+        << std::llround(hist.counts[i]) << " " << hist.counts[i] / total << " " << seen / total
+        << "\n";
+  }
+  out << "\n";
+}
+
+int main(int argc, char *argv[]) {
+  trace::RunReport report("inter_reference", argc, argv);
+  argparse::ArgumentParser program("inter_reference", "1.0");
+
+  program.add_argument("input_files")
+      .help("One or more CSV trace files, read as one trace in the given order")
+      .required()
+      .remaining();
+  program.add_argument("-f", "--format")
+      .default_value(std::string("7col"))
+      .choices("5col", "7col")
+      .help("Input layout; 7col measures seconds, 5col requests in between");
+  program.add_argument("-n", "--ratio")
+      .default_value(uint64_t{1})
+      .scan<'u', uint64_t>()
+      .help("Track only the keys hashed under 1/n");
+  program.add_argument("-m", "--max-memory")
+      .default_value(uint64_t{0})
+      .scan<'u', uint64_t>()
+      .help("Budget of the last-seen table in MB; the sampling rate drops to "
+            "stay within it (0 = no limit)");
+  program.add_argument("-b", "--sub-bucket-bits")
+      .default_value(2u)
+      .scan<'u', unsigned>()
+      .help("Each power of two is split into 2^b bins (0 = plain log2 bins)");
+  program.add_argument("-t", "--threads")
+      .default_value(std::max(1u, std::thread::hardware_concurrency()))
+      .scan<'u', unsigned>()
+      .help("Parsing threads; the output does not depend on this");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  std::vector<std::string> traceFiles;
+  try {
+    traceFiles = program.get<std::vector<std::string>>("input_files");
+    if (traceFiles.empty()) {
+      std::cerr << "No input files provided.\n";
+      return 1;
+    }
+  } catch (...) {
+    std::cerr << "No input files provided.\n";
+    return 1;
+  }
+
+  unsigned subBucketBits = program.get<unsigned>("--sub-bucket-bits");
+  if (subBucketBits > 16) {
+    std::cerr << "--sub-bucket-bits must be at most 16.\n";
+    return 1;
+  }
+  uint64_t n = program.get<uint64_t>("--ratio");
+  if (n == 0) {
+    std::cerr << "--ratio must be positive.\n";
+    return 1;
+  }
+  uint64_t maxKeys = (program.get<uint64_t>("--max-memory") << 20) / BYTES_PER_KEY;
+  if (program.get<uint64_t>("--max-memory") > 0 && maxKeys < 1000) {
+    std::cerr << "--max-memory is too small.\n";
+    return 1;
+  }
+  unsigned threads = std::max(1u, program.get<unsigned>("--threads"));
+  trace::TraceFormat format = trace::TraceFormat::SevenColumn;
+  trace::parseTraceFormat(program.get<std::string>("--format"), format);
+  bool timestamps = format == trace::TraceFormat::SevenColumn;
+
+  InterReference irt(trace::hashLimitForRatio(n), maxKeys, subBucketBits);
+  uint64_t requests[NUM_CLASSES] = {};
+  uint64_t badLines = 0;
+  uint64_t row = 0;
+  trace::ProgressReporter progress("inter_reference", trace::fileBytes(traceFiles));
+  int tableMap = progress.addMap("last seen");
+
+  // The workers parse and hash one window of the input and keep the
+  // requests under the current limit; this thread then runs them through
+  // the table in input order.
+  std::vector<WindowPart> parts(threads);
+  trace::StageTimer aggregate(trace::Stage::Aggregate);
+  for (const auto &filePath : traceFiles) {
+    trace::MappedFile in;
+    if (!in.open(filePath)) {
+      return 1;
+    }
+    std::string_view body = in.view();
+    if (trace::hasHeader(format)) {
+      body = body.substr(trace::nextLineStart(body, 0));
+    }
+    trace::forEachWindow(
+        body, threads, trace::WINDOW_BYTES,
+        [&](size_t t, std::string_view piece) {
+          WindowPart &part = parts[t];
+          part.sampled.clear();
+          std::fill(part.requests, part.requests + NUM_CLASSES, 0);
+          uint64_t limit = irt.limit();
+          trace::TraceRecord rec;
+          trace::StageTimer parse(trace::Stage::Parse);
+          trace::ProgressReporter::Batch counted(progress);
+          trace::forEachLine(piece, [&](std::string_view line) {
+            counted.add(1, line.size() + 1);
+            auto timed = parse.time(line.size() + 1);
+            if (!trace::parseRecord(line, format, rec)) {
+              part.badLines++;
+              return;
+            }
+            part.requests[ALL]++;
+            part.requests[trace::isUnderTwoKB(rec.objectSize) ? UNDER_2KB : OVER_2KB]++;
+            // 5col rows get their time (the row number) when they are
+            // folded in order.
+            uint64_t h = trace::hashKey(rec.key);
+            if (h <= limit || !timestamps) {
+              part.sampled.push_back({h, rec.timestamp, rec.objectSize});
+            }
+          });
+        },
+        [&]() {
+          auto timed = aggregate.block();
+          for (auto &part : parts) {
+            aggregate.count(part.sampled.size(), part.sampled.size() * sizeof(SampledRequest));
+            for (const SampledRequest &r : part.sampled) {
+              irt.access(r.keyHash, timestamps ? r.timestamp : row++, r.size);
+            }
+            for (int c = 0; c < NUM_CLASSES; ++c) {
+              requests[c] += part.requests[c];
+            }
+            badLines += part.badLines;
+            part.badLines = 0;
+          }
+          progress.publishMap(tableMap, trace::mapHealth(irt.table()));
+        });
+  }
+
+  std::cout << "# rate " << trace::hashLimitRate(irt.limit()) << " keys " << irt.table().size()
+            << "\n\n";
+  for (int c = 0; c < NUM_CLASSES; ++c) {
+    printIntervals(std::cout, irt, c, requests[c], timestamps ? "seconds" : "requests");
+  }
+  if (badLines > 0) {
+    std::cerr << "Skipped " << badLines << " malformed lines.\n";
+  }
+
+  return 0;
+}
@@ -8,6 +8,10 @@
 #include <vector>
 
 #include "csv.h"
+#include "common/csv_source.h"
+#include "common/progress.h"
+#include "common/reorder_buffer.h"
+#include "common/run_report.h"
 
 struct TraceEntry {
   uint64_t timestamp;
@@ -24,11 +28,92 @@ struct TraceEntry {
   }
 };
 
+struct EntryTimestamp {
+  uint64_t operator()(const TraceEntry& entry) const { return entry.timestamp; }
+};
+
+// One input file plus the reorder buffer that sorts its rows locally.
+struct InputSource {
+  std::unique_ptr<io::CSVReader<7>> reader;
+  trace::ReorderBuffer<TraceEntry, EntryTimestamp> buffer;
+  bool exhausted = false;
+
+  InputSource(const std::string& file, uint64_t reorderWindow,
+              trace::ProgressReporter& progress)
+      : reader(std::make_unique<io::CSVReader<7>>(
+            file, trace::countedFile(file, progress))),
+        buffer(reorderWindow) {}
+};
+
+// Parse and filter timers shared by all inputs.
+struct ReadTimers {
+  trace::StageTimer parse{trace::Stage::Parse};
+  trace::StageTimer filter{trace::Stage::Filter};
+};
+
+// Reads rows until one passes the operation and value size filters.
+bool readFilteredEntry(io::CSVReader<7>& reader,
+                       const std::unordered_set<std::string>& defaultOps,
+                       const std::unordered_set<std::string>& extendedOps,
+                       bool includeSetOps,
+                       ReadTimers& timers,
+                       TraceEntry& entry) {
+  while (true) {
+    {
+      auto timed = timers.parse.timeCall();
+      if (!reader.read_row(entry.timestamp,
+                           entry.key,
+                           entry.key_size,
+                           entry.value_size,
+                           entry.client_id,
+                           entry.operation,
+                           entry.TTL)) {
+        break;
+      }
+    }
+    timers.parse.count(1, 0);
+    auto timed = timers.filter.time();
+    if (defaultOps.count(entry.operation) > 0 ||
+        (includeSetOps && extendedOps.count(entry.operation) > 0)) {
+      if (entry.value_size > 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Returns the next row of `source` in timestamp order, as far as its reorder
+// window allows.
+bool nextEntry(InputSource& source,
+               size_t fileIndex,
+               const std::unordered_set<std::string>& defaultOps,
+               const std::unordered_set<std::string>& extendedOps,
+               bool includeSetOps,
+               ReadTimers& timers,
+               TraceEntry& entry) {
+  while (!source.exhausted && !source.buffer.hasReady()) {
+    TraceEntry next;
+    if (!readFilteredEntry(*source.reader, defaultOps, extendedOps,
+                           includeSetOps, timers, next)) {
+      source.exhausted = true;
+      break;
+    }
+    next.fileIndex = fileIndex;
+    source.buffer.push(std::move(next));
+  }
+  if (source.buffer.empty()) {
+    return false;
+  }
+  entry = source.buffer.pop();
+  return true;
+}
+
 void mergeAndTransformCsv(const std::vector<std::string>& inputFiles,
                           const std::string& outputFile,
                           int n,
-                          bool includeSetOps) {
-  std::vector<std::unique_ptr<io::CSVReader<7>>> readers;
+                          bool includeSetOps,
+                          uint64_t reorderWindow) {
   std::priority_queue<TraceEntry> minHeap;
   std::ofstream outFile(outputFile);
 
@@ -43,67 +128,42 @@ void mergeAndTransformCsv(const std::vector<std::string>& inputFiles,
   std::unordered_set<std::string> extendedOps = {
       "set", "cas", "add", "replace", "incr", "decr", "prepend", "append"};
   
-  size_t estimatedLines = 0;
-  for (const auto& file : inputFiles) {
-    std::ifstream inFile(file, std::ifstream::ate | std::ifstream::binary);
-    estimatedLines += inFile.tellg() / 90;
-  }
-  int processedLines = 0;
+  uint64_t inputBytes = trace::fileBytes(inputFiles);
+  trace::ProgressReporter progress("merge_traces", inputBytes);
+  trace::ProgressReporter::Batch counted(progress);
+  std::vector<InputSource> sources;
+  ReadTimers timers;
+  trace::StageTimer write(trace::Stage::Write);
+  timers.parse.count(0, inputBytes);
+  sources.reserve(inputFiles.size());
   for (size_t i = 0; i < inputFiles.size(); ++i) {
-    auto reader = std::make_unique<io::CSVReader<7>>(inputFiles[i]);
+    sources.emplace_back(inputFiles[i], reorderWindow, progress);
     TraceEntry entry;
-
-    while (reader->read_row(entry.timestamp,
-                         entry.key,
-                         entry.key_size,
-                         entry.value_size,
-                         entry.client_id,
-                         entry.operation,
-                         entry.TTL)) {
-      if (defaultOps.count(entry.operation) > 0 ||
-          (includeSetOps && extendedOps.count(entry.operation) > 0)) {
-	if(entry.value_size > 0) {     
-           entry.fileIndex = i;
-           minHeap.push(entry);
-	   break;
-	}
-      }
+    if (nextEntry(sources[i], i, defaultOps, extendedOps, includeSetOps,
+                  timers, entry)) {
+      minHeap.push(entry);
     }
-    readers.push_back(std::move(reader));
   }
 
   while (!minHeap.empty()) {
     TraceEntry smallest = minHeap.top();
     minHeap.pop();
 
-    outFile << smallest.timestamp << "," << smallest.key << ","
-            << smallest.key_size << "," << smallest.value_size << ","
-            << smallest.client_id << "," << smallest.operation << ","
-            << smallest.TTL << "\n";
-    
-    processedLines++;	
-    if (processedLines % 100000 == 0) {
-     	double progress = (double)processedLines / estimatedLines * 100;
-      	std::cout << "Progress: " << progress << "%\r" << std::flush;
+    {
+      auto timed = write.time();
+      outFile << smallest.timestamp << "," << smallest.key << ","
+              << smallest.key_size << "," << smallest.value_size << ","
+              << smallest.client_id << "," << smallest.operation << ","
+              << smallest.TTL << "\n";
     }
+    
+    counted.add(1, 0);
 
     size_t fileIndex = smallest.fileIndex;
-    TraceEntry nextEntry;
-    while(readers[fileIndex]->read_row(nextEntry.timestamp,
-                                     nextEntry.key,
-                                     nextEntry.key_size,
-                                     nextEntry.value_size,
-                                     nextEntry.client_id,
-                                     nextEntry.operation,
-                                     nextEntry.TTL)) {
-      nextEntry.fileIndex = fileIndex;
-      if (defaultOps.count(nextEntry.operation) > 0 ||
-          (includeSetOps && extendedOps.count(nextEntry.operation) > 0)) {
-	if(nextEntry.value_size > 0) {      
-            minHeap.push(nextEntry);
-	    break;
-	}
-      }
+    TraceEntry nextEntryRow;
+    if (nextEntry(sources[fileIndex], fileIndex, defaultOps, extendedOps,
+                  includeSetOps, timers, nextEntryRow)) {
+      minHeap.push(nextEntryRow);
     }
 
     if (minHeap.size() > 10000) {
@@ -111,14 +171,27 @@ void mergeAndTransformCsv(const std::vector<std::string>& inputFiles,
     }
   }
 
+  write.count(0, static_cast<uint64_t>(outFile.tellp()));
   outFile.close();
+
+  uint64_t lateRows = 0;
+  for (const auto& source : sources) {
+    lateRows += source.buffer.lateCount();
+  }
+  if (lateRows > 0) {
+    std::cerr << "Warning: " << lateRows << " rows arrived more than "
+              << reorderWindow << " time units out of order and were "
+              << "written out of order; consider a larger --reorder-window.\n";
+  }
   std::cout << "Merged trace saved to: " << outputFile << std::endl;
 }
 
 int main(int argc, char* argv[]) {
+  trace::RunReport report("merge_traces", argc, argv);
   if (argc < 4) {
     std::cerr << "Usage: " << argv[0]
-              << " output_file n [--include-set-ops] input_file1 [input_file2 ... input_filen]\n";
+              << " output_file n [--include-set-ops] [--reorder-window W]"
+                 " input_file1 [input_file2 ... input_filen]\n";
     return 1;
   }
   std::string outputFile = argv[1];
@@ -128,12 +201,25 @@ int main(int argc, char* argv[]) {
     return 1;
   }
   bool includeSetOps = false;
+  uint64_t reorderWindow = 0;
   int inputStartIndex = 3;
-  if (std::string(argv[3]) == "--include-set-ops") {
-    includeSetOps = true;
-    inputStartIndex++;
+  while (inputStartIndex < argc) {
+    std::string arg = argv[inputStartIndex];
+    if (arg == "--include-set-ops") {
+      includeSetOps = true;
+      inputStartIndex++;
+    } else if (arg == "--reorder-window" && inputStartIndex + 1 < argc) {
+      reorderWindow = std::stoull(argv[inputStartIndex + 1]);
+      inputStartIndex += 2;
+    } else {
+      break;
+    }
+  }
+  if (inputStartIndex >= argc) {
+    std::cerr << "No input files provided.\n";
+    return 1;
   }
   std::vector<std::string> inputFiles(argv + inputStartIndex, argv + argc);
-  mergeAndTransformCsv(inputFiles, outputFile, n, includeSetOps);
+  mergeAndTransformCsv(inputFiles, outputFile, n, includeSetOps, reorderWindow);
   return 0;
 }
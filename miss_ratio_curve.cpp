@@ -0,0 +1,410 @@
+#include "include/argparse/argparse.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "common/key_hash.h"
+#include "common/line_scan.h"
+#include "common/log_linear_histogram.h"
+#include "common/mapped_file.h"
+#include "common/progress.h"
+#include "common/reuse_distance.h"
+#include "common/run_report.h"
+#include "common/space_saving.h"
+#include "common/trace_filter.h"
+#include "common/trace_format.h"
+#include "common/trace_record.h"
+
+// Classes with a curve each, as in trace_info; every class is its own cache.
+enum SizeClass { ALL, UNDER_2KB, OVER_2KB, NUM_CLASSES };
+const char *const CLASS_NAMES[NUM_CLASSES] = {"All", "Under 2KB", "Over 2KB"};
+
+// SHARDS over one class: the keys hashed at or below `limit` go through
+// exact stacks by objects and by bytes, and their distances are scaled by
+// the inverse of the sampling rate. With a key budget the largest sampled
+// hash is dropped whenever the budget is exceeded and the limit follows it
+// down, so memory stays bounded whatever the trace.
+//
+// The heaviest keys are tracked exactly besides the sample: each of them
+// counts once in a distance, and each of their requests counts once. Under
+// heavy skew they hold much of the traffic and most of the bytes, and
+// whether the sample holds a few of them would decide the curve. Besides
+// the stacks of every tracked key, the exact and the sampled keys have
+// stacks of their own, so a distance splits into its exact part and its
+// sampled part, and only the latter is scaled.
+struct ClassCurve {
+  trace::ReuseDistance objects{trace::ReuseDistance::Weight::Objects, 1u << 16};
+  trace::ReuseDistance bytes{trace::ReuseDistance::Weight::Bytes, 1u << 16};
+  trace::ReuseDistance exactObjects{trace::ReuseDistance::Weight::Objects, 1u << 12};
+  trace::ReuseDistance exactBytes{trace::ReuseDistance::Weight::Bytes, 1u << 12};
+  trace::ReuseDistance sampledObjects{trace::ReuseDistance::Weight::Objects, 1u << 16};
+  trace::ReuseDistance sampledBytes{trace::ReuseDistance::Weight::Bytes, 1u << 16};
+  uint64_t limit;
+  std::priority_queue<uint64_t> largest;  // sampled hashes, with a budget only
+  // Scaled distances, each weighed by the requests and bytes it stands for.
+  trace::WeightedHistogram byObjects;
+  trace::WeightedHistogram byBytes;
+  double coldRequests = 0;
+  double coldBytes = 0;
+  uint64_t requests = 0;  // every request of the class, sampled or not
+  uint64_t requestBytes = 0;
+  uint64_t sampledRequests = 0;
+  uint64_t exactRequests = 0;
+  uint64_t exactKeys = 0;
+
+  ClassCurve(uint64_t initialLimit, unsigned subBucketBits)
+      : limit(initialLimit), byObjects(subBucketBits), byBytes(subBucketBits) {}
+
+  void access(uint64_t h, uint32_t size, bool exact, uint64_t maxKeys) {
+    if (!exact && h > limit) {
+      return;
+    }
+    double scale = 1.0 / trace::hashLimitRate(limit);
+    double weight = exact ? 1.0 : scale;
+    (exact ? exactRequests : sampledRequests)++;
+    uint64_t objectDistance = objects.access(h, size);
+    uint64_t byteDistance = bytes.access(h, size);
+    uint64_t sampledObjectDistance;
+    uint64_t sampledByteDistance;
+    if (exact) {
+      sampledObjectDistance = objectDistance - exactObjects.access(h, size);
+      sampledByteDistance = byteDistance - exactBytes.access(h, size);
+    } else {
+      sampledObjectDistance = sampledObjects.access(h, size);
+      sampledByteDistance = sampledBytes.access(h, size);
+    }
+    if (objectDistance == 0) {
+      coldRequests += weight;
+      coldBytes += weight * size;
+      if (exact) {
+        exactKeys++;
+      } else if (maxKeys > 0) {
+        largest.push(h);
+        if (largest.size() > maxKeys) {
+          objects.erase(largest.top());
+          bytes.erase(largest.top());
+          sampledObjects.erase(largest.top());
+          sampledBytes.erase(largest.top());
+          largest.pop();
+          limit = largest.top();
+        }
+      }
+      return;
+    }
+    double objectEstimate = (objectDistance - sampledObjectDistance) + sampledObjectDistance * scale;
+    double byteEstimate = (byteDistance - sampledByteDistance) + sampledByteDistance * scale;
+    byObjects.record(std::llround(objectEstimate), weight, weight * size);
+    byBytes.record(std::llround(byteEstimate), weight, weight * size);
+  }
+};
+
+// A request that passed the widest class limit or is of an exact key, in
+// input order.
+struct SampledRequest {
+  uint64_t keyHash;
+  uint32_t size;
+  bool exact;
+};
+
+// Per-worker share of one window of the input.
+struct WindowPart {
+  std::vector<SampledRequest> sampled;
+  uint64_t requests[NUM_CLASSES] = {};
+  uint64_t requestBytes[NUM_CLASSES] = {};
+  uint64_t badLines = 0;
+};
+
+// Miss ratios of LRU caches as large as each bin's upper bound. SHARDS_adj:
+// the difference between the exact request count and the sampled estimate
+// goes to the smallest distances, which removes most of the sampling error
+// from the top of the curve. Byte miss ratios are a share of the sampled
+// bytes instead: with heavy-tailed sizes the sampled byte total can be far
+// off, and moving that gap to the smallest cache would skew the whole curve.
+void printCurve(std::ostream &out, const ClassCurve &curve, const trace::WeightedHistogram &hist,
+                const std::string &title, const std::string &unit) {
+  out << "=== " << title << " (" << unit << ") ===\n";
+  out << "# requests " << curve.requests << " request_bytes " << curve.requestBytes
+      << " sampled_requests " << curve.sampledRequests << " sampled_keys "
+      << curve.objects.keys() - curve.exactKeys << " exact_requests " << curve.exactRequests
+      << " exact_keys " << curve.exactKeys << " rate " << trace::hashLimitRate(curve.limit)
+      << "\n";
+  if (curve.limit != UINT64_MAX) {
+    out << "# estimate: hot keys beyond exact_keys make it noisy, byte miss ratios most\n";
+  }
+  out << "# cache_size miss_ratio byte_miss_ratio\n";
+  if (curve.requests == 0) {
+    out << "\n";
+    return;
+  }
+  double estimated = curve.coldRequests;
+  double estimatedBytes = curve.coldBytes;
+  size_t first = hist.bins.numBuckets();
+  size_t last = 0;
+  for (size_t i = 0; i < hist.bins.numBuckets(); ++i) {
+    estimated += hist.counts[i];
+    estimatedBytes += hist.bytes[i];
+    if (hist.counts[i] > 0) {
+      first = std::min(first, i);
+      last = i;
+    }
+  }
+  if (first > last) {
+    out << "\n";
+    return;
+  }
+  double hits = static_cast<double>(curve.requests) - estimated;
+  double hitBytes = 0;
+  for (size_t i = first; i <= last; ++i) {
+    hits += hist.counts[i];
+    hitBytes += hist.bytes[i];
+    double miss = 1 - hits / curve.requests;
+    double byteMiss = estimatedBytes > 0 ? 1 - hitBytes / estimatedBytes : 0;
+    out << hist.bins.upperBound(i) << " " << std::min(1.0, std::max(0.0, miss)) << " "
+        << std::min(1.0, std::max(0.0, byteMiss)) << "\n";
+  }
+  out << "\n";
+}
+
+// The `count` keys with the most bytes in Under 2KB and in Over 2KB, from a
+// first pass over the input. Only one request in 16, chosen by its offset
+// in the file, is parsed and counted: the keys that matter have thousands.
+// Space-Saving summaries of fixed chunks are merged in input order, so the
+// keys do not depend on --threads.
+bool findExactKeys(const std::vector<std::string> &traceFiles, trace::TraceFormat format,
+                   size_t count, unsigned threads, trace::ProgressReporter &progress,
+                   robin_hood::unordered_flat_set<uint64_t> &exactKeys) {
+  const size_t CHUNK_BYTES = size_t{32} << 20;
+  const uint64_t REQUEST_LIMIT = trace::hashLimitForRatio(16);
+  std::vector<trace::SpaceSaving> totals(NUM_CLASSES, trace::SpaceSaving(4 * count));
+  std::vector<trace::SpaceSaving> parts(threads * NUM_CLASSES, trace::SpaceSaving(4 * count));
+  for (const auto &filePath : traceFiles) {
+    trace::MappedFile in;
+    if (!in.open(filePath)) {
+      return false;
+    }
+    std::string_view body = in.view();
+    if (trace::hasHeader(format)) {
+      body = body.substr(trace::nextLineStart(body, 0));
+    }
+    std::vector<size_t> bounds{0};
+    while (bounds.back() < body.size()) {
+      bounds.push_back(trace::nextLineStart(body, bounds.back() + CHUNK_BYTES));
+    }
+    for (size_t first = 0; first + 1 < bounds.size(); first += threads) {
+      size_t chunks = std::min<size_t>(threads, bounds.size() - 1 - first);
+      trace::parallelFor(chunks, [&](size_t t) {
+        trace::TraceRecord rec;
+        trace::StageTimer parse(trace::Stage::Parse);
+        trace::ProgressReporter::Batch counted(progress);
+        trace::forEachLine(body.substr(bounds[first + t], bounds[first + t + 1] - bounds[first + t]),
+                           [&](std::string_view line) {
+                             counted.add(1, line.size() + 1);
+                             uint64_t offset = static_cast<uint64_t>(line.data() - body.data());
+                             if (trace::mixHash(offset) > REQUEST_LIMIT) {
+                               return;
+                             }
+                             auto timed = parse.time(line.size() + 1);
+                             if (!trace::parseRecord(line, format, rec)) {
+                               return;
+                             }
+                             int c = trace::isUnderTwoKB(rec.objectSize) ? UNDER_2KB : OVER_2KB;
+                             parts[t * NUM_CLASSES + c].add(trace::hashKey(rec.key), {},
+                                                            rec.objectSize);
+                           });
+      });
+      for (size_t t = 0; t < chunks; ++t) {
+        for (int c = UNDER_2KB; c < NUM_CLASSES; ++c) {
+          totals[c].merge(parts[t * NUM_CLASSES + c]);
+          parts[t * NUM_CLASSES + c].clear();
+        }
+      }
+    }
+  }
+  for (int c = UNDER_2KB; c < NUM_CLASSES; ++c) {
+    for (const auto &counter : totals[c].top(count)) {
+      exactKeys.insert(counter.keyHash);
+    }
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  trace::RunReport report("miss_ratio_curve", argc, argv);
+  argparse::ArgumentParser program("miss_ratio_curve", "1.0");
+
+  program.add_argument("input_files")
+      .help("One or more CSV trace files, read as one trace in the given order")
+      .required()
+      .remaining();
+  program.add_argument("-m", "--mode")
+      .default_value(std::string("fixed-rate"))
+      .choices("fixed-rate", "fixed-size")
+      .help("fixed-rate: sample 1/n of the keys; fixed-size: start at 1/n and "
+            "lower the rate so each class keeps at most --max-keys keys");
+  program.add_argument("-n", "--ratio")
+      .default_value(uint64_t{100})
+      .scan<'u', uint64_t>()
+      .help("Sample the keys hashed under 1/n");
+  program.add_argument("--max-keys")
+      .default_value(uint64_t{0})
+      .scan<'u', uint64_t>()
+      .help("Distinct key budget per class for fixed-size");
+  program.add_argument("--exact-keys")
+      .default_value(uint64_t{1024})
+      .scan<'u', uint64_t>()
+      .help("Track the keys with the most bytes exactly, this many per size class; "
+            "0 for plain SHARDS");
+  program.add_argument("-b", "--sub-bucket-bits")
+      .default_value(3u)
+      .scan<'u', unsigned>()
+      .help("Cache sizes: each power of two is split into 2^b points");
+  program.add_argument("-f", "--format")
+      .default_value(std::string("5col"))
+      .choices("5col", "7col")
+      .help("Input layout");
+  program.add_argument("-t", "--threads")
+      .default_value(std::max(1u, std::thread::hardware_concurrency()))
+      .scan<'u', unsigned>()
+      .help("Threads parsing and hashing; the curves do not depend on this");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  std::vector<std::string> traceFiles;
+  try {
+    traceFiles = program.get<std::vector<std::string>>("input_files");
+    if (traceFiles.empty()) {
+      std::cerr << "No input files provided.\n";
+      return 1;
+    }
+  } catch (...) {
+    std::cerr << "No input files provided.\n";
+    return 1;
+  }
+
+  unsigned subBucketBits = program.get<unsigned>("--sub-bucket-bits");
+  if (subBucketBits > 16) {
+    std::cerr << "--sub-bucket-bits must be at most 16.\n";
+    return 1;
+  }
+  uint64_t n = program.get<uint64_t>("--ratio");
+  if (n == 0) {
+    std::cerr << "--ratio must be positive.\n";
+    return 1;
+  }
+  uint64_t maxKeys = 0;
+  if (program.get<std::string>("--mode") == "fixed-size") {
+    maxKeys = program.get<uint64_t>("--max-keys");
+    if (maxKeys == 0) {
+      std::cerr << "fixed-size needs a positive --max-keys.\n";
+      return 1;
+    }
+  }
+  unsigned threads = std::max(1u, program.get<unsigned>("--threads"));
+  trace::TraceFormat format = trace::TraceFormat::FiveColumn;
+  trace::parseTraceFormat(program.get<std::string>("--format"), format);
+
+  // With -n 1 every key is in the sample already.
+  uint64_t exactKeyCount = n > 1 ? program.get<uint64_t>("--exact-keys") : 0;
+
+  std::vector<ClassCurve> curves(NUM_CLASSES,
+                                 ClassCurve(trace::hashLimitForRatio(n), subBucketBits));
+  // The first pass for the exact keys reads the input once more.
+  trace::ProgressReporter progress("miss_ratio_curve",
+                                   trace::fileBytes(traceFiles) * (exactKeyCount > 0 ? 2 : 1));
+  robin_hood::unordered_flat_set<uint64_t> exactKeys;
+  if (exactKeyCount > 0 &&
+      !findExactKeys(traceFiles, format, exactKeyCount, threads, progress, exactKeys)) {
+    return 1;
+  }
+  int keysMaps[NUM_CLASSES];
+  for (int c = 0; c < NUM_CLASSES; ++c) {
+    keysMaps[c] = progress.addMap(CLASS_NAMES[c]);
+  }
+  uint64_t badLines = 0;
+
+  // The workers parse and hash one window of the input and keep the
+  // requests under the widest limit; this thread then runs them through the
+  // stacks in input order.
+  std::vector<WindowPart> parts(threads);
+  trace::StageTimer aggregate(trace::Stage::Aggregate);
+  for (const auto &filePath : traceFiles) {
+    trace::MappedFile in;
+    if (!in.open(filePath)) {
+      return 1;
+    }
+    std::string_view body = in.view();
+    if (trace::hasHeader(format)) {
+      body = body.substr(trace::nextLineStart(body, 0));
+    }
+    trace::forEachWindow(
+        body, threads, trace::WINDOW_BYTES,
+        [&](size_t t, std::string_view piece) {
+          WindowPart &part = parts[t];
+          part.sampled.clear();
+          uint64_t widest = std::max({curves[ALL].limit, curves[UNDER_2KB].limit,
+                                      curves[OVER_2KB].limit});
+          trace::TraceRecord rec;
+          trace::StageTimer parse(trace::Stage::Parse);
+          trace::ProgressReporter::Batch counted(progress);
+          trace::forEachLine(piece, [&](std::string_view line) {
+            counted.add(1, line.size() + 1);
+            auto timed = parse.time(line.size() + 1);
+            if (!trace::parseRecord(line, format, rec)) {
+              part.badLines++;
+              return;
+            }
+            int c = trace::isUnderTwoKB(rec.objectSize) ? UNDER_2KB : OVER_2KB;
+            part.requests[ALL]++;
+            part.requestBytes[ALL] += rec.objectSize;
+            part.requests[c]++;
+            part.requestBytes[c] += rec.objectSize;
+            uint64_t h = trace::hashKey(rec.key);
+            bool exact = !exactKeys.empty() && exactKeys.count(h) > 0;
+            if (h <= widest || exact) {
+              part.sampled.push_back({h, rec.objectSize, exact});
+            }
+          });
+        },
+        [&]() {
+          auto timed = aggregate.block();
+          for (auto &part : parts) {
+            aggregate.count(part.sampled.size(), part.sampled.size() * sizeof(SampledRequest));
+            for (const SampledRequest &r : part.sampled) {
+              curves[ALL].access(r.keyHash, r.size, r.exact, maxKeys);
+              curves[trace::isUnderTwoKB(r.size) ? UNDER_2KB : OVER_2KB].access(
+                  r.keyHash, r.size, r.exact, maxKeys);
+            }
+          }
+          for (int c = 0; c < NUM_CLASSES; ++c) {
+            progress.publishMap(keysMaps[c], trace::mapHealth(curves[c].objects.index()));
+          }
+        });
+  }
+  for (auto &part : parts) {
+    for (int c = 0; c < NUM_CLASSES; ++c) {
+      curves[c].requests += part.requests[c];
+      curves[c].requestBytes += part.requestBytes[c];
+    }
+    badLines += part.badLines;
+  }
+
+  for (int c = 0; c < NUM_CLASSES; ++c) {
+    std::string title = std::string("Miss ratio curve: ") + CLASS_NAMES[c];
+    printCurve(std::cout, curves[c], curves[c].byObjects, title, "objects");
+    printCurve(std::cout, curves[c], curves[c].byBytes, title, "bytes");
+  }
+  if (badLines > 0) {
+    std::cerr << "Skipped " << badLines << " malformed lines.\n";
+  }
+
+  return 0;
+}
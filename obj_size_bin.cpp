@@ -1,17 +1,138 @@
-#include <cmath>
-#include <cassert>
 #include "include/argparse/argparse.hpp"
-#include "include/csv/csv.h"
-#include "include/robin_hood/robin_hood.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
 #include <vector>
 
+#include "include/robin_hood/robin_hood.h"
+#include "common/key_hash.h"
+#include "common/line_scan.h"
+#include "common/log_linear_histogram.h"
+#include "common/mapped_file.h"
+#include "common/progress.h"
+#include "common/run_report.h"
+#include "common/trace_format.h"
+#include "common/trace_record.h"
+
+enum class ObjectSizeRule { None, First, Last };
+
+// Compact per-key table: 64-bit key hash -> the object size that counts
+// for the object-weighted view.
+using ObjectSizes = robin_hood::unordered_flat_map<uint64_t, uint32_t>;
+
+// A request's key hash and object size, on its way to the shard that owns
+// the key.
+struct KeyObject {
+  uint64_t keyHash;
+  uint32_t size;
+};
+
+// Histograms of one worker; merged at the end. objectSize counts requests,
+// objectBytes weighs each request by its size. `pending` holds the current
+// window's KeyObjects, one buffer per shard of the per-key table.
+struct SizeProfile {
+  trace::LogLinearHistogram keySize;
+  trace::LogLinearHistogram valueSize;
+  trace::LogLinearHistogram objectSize;
+  trace::LogLinearHistogram objectBytes;
+  std::vector<std::vector<KeyObject>> pending;
+  uint64_t badLines = 0;
+
+  explicit SizeProfile(unsigned subBucketBits)
+      : keySize(subBucketBits), valueSize(subBucketBits),
+        objectSize(subBucketBits), objectBytes(subBucketBits) {}
+
+  void merge(const SizeProfile &other) {
+    keySize.merge(other.keySize);
+    valueSize.merge(other.valueSize);
+    objectSize.merge(other.objectSize);
+    objectBytes.merge(other.objectBytes);
+    badLines += other.badLines;
+  }
+};
+
+// Folds requests into a shard in input order: "first" keeps the entry
+// already present and "last" overwrites it.
+void foldObjects(ObjectSizes &shard, const std::vector<KeyObject> &requests,
+                 ObjectSizeRule rule) {
+  for (const KeyObject &r : requests) {
+    if (rule == ObjectSizeRule::First) {
+      shard.try_emplace(r.keyHash, r.size);
+    } else {
+      shard[r.keyHash] = r.size;
+    }
+  }
+}
+
+// Request-, byte- and object-weighted views of the object size, per bin.
+void printObjectSizeViews(std::ostream &out, const SizeProfile &profile,
+                          const std::vector<ObjectSizes> &shards, ObjectSizeRule rule) {
+  unsigned bits = profile.objectSize.subBucketBits();
+  trace::LogLinearHistogram uniqueObjects(bits);
+  trace::LogLinearHistogram uniqueBytes(bits);
+  for (const ObjectSizes &objects : shards) {
+    for (const auto &kv : objects) {
+      uniqueObjects.record(kv.second);
+      uniqueBytes.record(kv.second, kv.second);
+    }
+  }
+
+  out << "=== Object size ===\n";
+  out << "# lower upper requests request_bytes";
+  if (rule != ObjectSizeRule::None) {
+    out << " objects object_bytes";
+  }
+  out << "\n";
+  size_t first = std::min(profile.objectSize.firstNonEmpty(), uniqueObjects.firstNonEmpty());
+  size_t last = std::max(profile.objectSize.lastNonEmpty(), uniqueObjects.lastNonEmpty());
+  for (size_t i = first; i <= last && i < profile.objectSize.numBuckets(); ++i) {
+    out << profile.objectSize.lowerBound(i) << " " << profile.objectSize.upperBound(i)
+        << " " << profile.objectSize.count(i) << " " << profile.objectBytes.count(i);
+    if (rule != ObjectSizeRule::None) {
+      out << " " << uniqueObjects.count(i) << " " << uniqueBytes.count(i);
+    }
+    out << "\n";
+  }
+  out << "\n";
+}
+
+void printHistogram(std::ostream &out, const trace::LogLinearHistogram &hist,
+                    const std::string &title) {
+  out << "=== " << title << " ===\n";
+  out << "# lower upper count\n";
+  size_t last = hist.lastNonEmpty();
+  for (size_t i = hist.firstNonEmpty(); i <= last && i < hist.numBuckets(); ++i) {
+    out << hist.lowerBound(i) << " " << hist.upperBound(i) << " "
+        << hist.count(i) << "\n";
+  }
+  out << "\n";
+}
+
 int main(int argc, char *argv[]) {
-  argparse::ArgumentParser program("csv_analyzer", "1.0");
+  trace::RunReport report("obj_size_bin", argc, argv);
+  argparse::ArgumentParser program("obj_size_bin", "1.0");
 
   program.add_argument("input_files")
       .help("One or more CSV trace files to analyze")
       .required()
       .remaining();
+  program.add_argument("-b", "--sub-bucket-bits")
+      .default_value(2u)
+      .scan<'u', unsigned>()
+      .help("Each power of two is split into 2^b bins (0 = plain log2 bins)");
+  program.add_argument("-f", "--format")
+      .default_value(std::string("5col"))
+      .choices("5col", "7col")
+      .help("Input layout");
+  program.add_argument("-s", "--object-size")
+      .default_value(std::string("last"))
+      .choices("first", "last", "none")
+      .help("Size that places a key in the object-weighted view: its first "
+            "or last request; none skips the per-key table");
+  program.add_argument("-t", "--threads")
+      .default_value(std::max(1u, std::thread::hardware_concurrency()))
+      .scan<'u', unsigned>()
+      .help("Worker threads");
 
   try {
     program.parse_args(argc, argv);
@@ -33,43 +154,94 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  uint32_t numBins = 0;
-  uint32_t startByte = 64;
-  uint32_t endByte = 512 * 1024;
-
-  while (startByte <= endByte) {
-    startByte *= 2;
-    numBins++;
+  unsigned subBucketBits = program.get<unsigned>("--sub-bucket-bits");
+  if (subBucketBits > 16) {
+    std::cerr << "--sub-bucket-bits must be at most 16.\n";
+    return 1;
   }
+  unsigned threads = std::max(1u, program.get<unsigned>("--threads"));
+  trace::TraceFormat format = trace::TraceFormat::FiveColumn;
+  trace::parseTraceFormat(program.get<std::string>("--format"), format);
+  auto ruleName = program.get<std::string>("--object-size");
+  ObjectSizeRule rule = ruleName == "first"  ? ObjectSizeRule::First
+                        : ruleName == "last" ? ObjectSizeRule::Last
+                                             : ObjectSizeRule::None;
 
-  auto ceil_log2 = [](uint32_t val) {
-    uint32_t floor_log = 31 - __builtin_clz(val);
-    return (val == (1u << floor_log)) ? floor_log : floor_log + 1;
-  };
-  // Simple test
-  assert(ceil_log2(64) == 6);
-  assert(ceil_log2(62) == 6);
-  std::cout << ceil_log2(31) << std::endl;
-
-  std::vector<uint64_t> numObjs(numBins + 1, 0);
-
+  // Every worker fills its own histograms over one line-aligned part of a
+  // window of the input. The per-key table is sharded on the key hash, so
+  // each key has one owner whatever the number of threads: workers hand the
+  // window's requests to the shards, which then fold them in input order,
+  // in parallel.
+  // Windows smaller than the usual keep the handed-over requests (16 bytes
+  // each) small.
+  const size_t SHARDED_WINDOW_BYTES = size_t{4} << 20;
+  std::vector<SizeProfile> profiles(threads, SizeProfile(subBucketBits));
+  std::vector<ObjectSizes> shards(rule == ObjectSizeRule::None ? 0 : threads);
+  for (auto &profile : profiles) {
+    profile.pending.resize(shards.size());
+  }
+  trace::ProgressReporter progress("obj_size_bin", trace::fileBytes(traceFiles));
   for (const auto &filePath : traceFiles) {
-    io::CSVReader<5> csvIn(filePath);
-    csvIn.read_header(io::ignore_extra_column, "key", "op", "size", "op_count",
-                      "key_size");
-
-    std::string key, op;
-    uint32_t size = 0, op_count = 0, key_size = 0;
-
-    while (csvIn.read_row(key, op, size, op_count, key_size)) {
-      size = std::max(static_cast<uint32_t>(64), size);
-      uint32_t binIdx = ceil_log2(size) - 6;
-      numObjs[std::min(binIdx, numBins)]++;
+    trace::MappedFile in;
+    if (!in.open(filePath)) {
+      return 1;
+    }
+    std::string_view body = in.view();
+    if (trace::hasHeader(format)) {
+      body = body.substr(trace::nextLineStart(body, 0));
     }
+    trace::forEachWindow(
+        body, threads, SHARDED_WINDOW_BYTES,
+        [&](size_t t, std::string_view piece) {
+          SizeProfile &profile = profiles[t];
+          for (auto &pending : profile.pending) {
+            pending.clear();
+          }
+          trace::TraceRecord rec;
+          trace::StageTimer parse(trace::Stage::Parse);
+          trace::StageTimer aggregate(trace::Stage::Aggregate);
+          trace::ProgressReporter::Batch counted(progress);
+          trace::forEachLine(piece, [&](std::string_view line) {
+            counted.add(1, line.size() + 1);
+            {
+              auto timed = parse.time(line.size() + 1);
+              if (!trace::parseRecord(line, format, rec)) {
+                profile.badLines++;
+                return;
+              }
+            }
+            auto timed = aggregate.time();
+            profile.keySize.record(rec.keySize);
+            profile.valueSize.record(rec.valueSize);
+            profile.objectSize.record(rec.objectSize);
+            profile.objectBytes.record(rec.objectSize, rec.objectSize);
+            if (!shards.empty()) {
+              uint64_t h = trace::hashKey(rec.key);
+              profile.pending[h % shards.size()].push_back({h, rec.objectSize});
+            }
+          });
+        },
+        [&]() {
+          trace::parallelFor(shards.size(), [&](size_t s) {
+            trace::StageTimer aggregate(trace::Stage::Aggregate);
+            auto timed = aggregate.block();
+            for (const auto &profile : profiles) {
+              foldObjects(shards[s], profile.pending[s], rule);
+            }
+          });
+        });
+  }
+
+  SizeProfile total(subBucketBits);
+  for (const auto &profile : profiles) {
+    total.merge(profile);
   }
 
-  for (std::size_t i = 0; i < numObjs.size(); ++i) {
-    std::cout << 64 * static_cast<uint32_t>(std::pow(2, i)) << " " << numObjs[i] << std::endl;
+  printObjectSizeViews(std::cout, total, shards, rule);
+  printHistogram(std::cout, total.keySize, "Key size");
+  printHistogram(std::cout, total.valueSize, "Value size");
+  if (total.badLines > 0) {
+    std::cerr << "Skipped " << total.badLines << " malformed lines.\n";
   }
 
   return 0;
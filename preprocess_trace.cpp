@@ -1,64 +1,20 @@
 #include <iostream>
 #include <fstream>
-#include <sstream>
-#include <vector>
 #include <string>
 
-struct Row {
-    uint64_t timestamp;
-    std::string key;
-    uint32_t key_size;
-    uint32_t value_size;
-    uint64_t client_id;
-    std::string operation;
-    uint64_t TTL;
-};
-
-// Helper function to fix the key field by removing commas
-std::string fixKey(const std::vector<std::string>& fields, size_t startIdx, size_t endIdx) {
-    std::string fixedKey;
-    for (size_t i = startIdx; i <= endIdx; ++i) {
-        fixedKey += fields[i];
-    }
-    return fixedKey;
-}
-
-// Function to parse a line into a Row structure
-bool parseLine(const std::string& line, Row& row) {
-    std::istringstream ss(line);
-    std::string token;
-    std::vector<std::string> fields;
-
-    // Split line into tokens
-    while (std::getline(ss, token, ',')) {
-        fields.push_back(token);
-    }
-
-    // Ensure at least 7 fields exist
-    if (fields.size() < 7) {
-        return false; // Invalid row
-    }
-
-    // The key field may span multiple tokens
-    size_t keyEndIdx = fields.size() - 6;
+#include "common/progress.h"
+#include "common/raw_trace.h"
+#include "common/reorder_buffer.h"
+#include "common/run_report.h"
+#include "common/trace_filter.h"
 
-    try {
-        row.timestamp = std::stoull(fields[0]);
-        row.key = fixKey(fields, 1, keyEndIdx);
-        row.key_size = std::stoul(fields[keyEndIdx + 1]);
-        row.value_size = std::stoul(fields[keyEndIdx + 2]);
-        row.client_id = std::stoull(fields[keyEndIdx + 3]);
-        row.operation = fields[keyEndIdx + 4];
-        row.TTL = std::stoull(fields[keyEndIdx + 5]);
-    } catch (...) {
-        return false; // Conversion error
-    }
-
-    return true;
-}
+struct RowTimestamp {
+    uint64_t operator()(const trace::RawRow& row) const { return row.timestamp; }
+};
 
 // Function to process the CSV file
-void processCSV(const std::string& inputFile, const std::string& outputFile) {
+void processCSV(const std::string& inputFile, const std::string& outputFile,
+                uint64_t reorderWindow) {
     std::ifstream inFile(inputFile);
     std::ofstream outFile(outputFile);
 
@@ -67,26 +23,59 @@ void processCSV(const std::string& inputFile, const std::string& outputFile) {
         return;
     }
 
+    trace::ReorderBuffer<trace::RawRow, RowTimestamp> reorder(reorderWindow);
+
+    trace::StageTimer read(trace::Stage::Read);
+    trace::StageTimer parse(trace::Stage::Parse);
+    trace::StageTimer filter(trace::Stage::Filter);
+    trace::StageTimer write(trace::Stage::Write);
+
+    trace::ProgressReporter progress("preprocess_trace", trace::fileBytes({inputFile}));
+    trace::ProgressReporter::Batch counted(progress);
     std::string line;
-    while (std::getline(inFile, line)) {
-        Row row;
-        if (!parseLine(line, row)) {
-            continue; // Skip invalid rows
+    while (true) {
+        {
+            auto timed = read.timeCall();
+            if (!std::getline(inFile, line)) {
+                break;
+            }
+        }
+        read.count(1, line.size() + 1);
+        counted.add(1, line.size() + 1);
+        trace::RawRow row;
+        {
+            auto timed = parse.time(line.size() + 1);
+            if (!trace::parseRawLine(line, row)) {
+                continue; // Skip invalid rows
+            }
         }
 
-        // Filtering conditions
-        if (row.operation != "get" && row.operation != "gets" && row.operation != "delete") {
-            continue; // Remove rows with invalid operation
+        // Filtering conditions: only get/gets/delete, and no get/gets with
+        // value_size == 0
+        {
+            auto timed = filter.time();
+            if (!trace::keepRow(row.operation, row.value_size)) {
+                continue;
+            }
         }
 
-        if ((row.operation == "get" || row.operation == "gets") && row.value_size == 0) {
-            continue; // Remove rows with get/gets and value_size == 0
+        // Write the processed rows that left the reorder window
+        reorder.push(std::move(row));
+        while (reorder.hasReady()) {
+            auto timed = write.time();
+            trace::writeRawRow(outFile, reorder.pop());
         }
+    }
+    while (!reorder.empty()) {
+        auto timed = write.time();
+        trace::writeRawRow(outFile, reorder.pop());
+    }
+    write.count(0, static_cast<uint64_t>(outFile.tellp()));
 
-        // Write the processed row to the output file
-        outFile << row.timestamp << "," << row.key << "," << row.key_size << ","
-                << row.value_size << "," << row.client_id << "," << row.operation << ","
-                << row.TTL << "\n";
+    if (reorder.lateCount() > 0) {
+        std::cerr << "Warning: " << reorder.lateCount() << " rows arrived more than "
+                  << reorderWindow << " time units out of order and were written "
+                  << "out of order; consider a larger --reorder-window." << std::endl;
     }
 
     inFile.close();
@@ -94,15 +83,18 @@ void processCSV(const std::string& inputFile, const std::string& outputFile) {
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <input_file> <output_file>" << std::endl;
+    trace::RunReport report("preprocess_trace", argc, argv);
+    if (argc != 3 && !(argc == 5 && std::string(argv[3]) == "--reorder-window")) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <input_file> <output_file> [--reorder-window W]" << std::endl;
         return 1;
     }
 
     std::string inputFile = argv[1];
     std::string outputFile = argv[2];
+    uint64_t reorderWindow = argc == 5 ? std::stoull(argv[4]) : 0;
 
-    processCSV(inputFile, outputFile);
+    processCSV(inputFile, outputFile, reorderWindow);
 
     std::cout << "CSV processing completed. Processed data saved to " << outputFile << std::endl;
     return 0;
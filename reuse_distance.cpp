@@ -0,0 +1,160 @@
+#include "include/argparse/argparse.hpp"
+#include <iostream>
+#include <vector>
+
+#include "common/key_hash.h"
+#include "common/line_scan.h"
+#include "common/log_linear_histogram.h"
+#include "common/mapped_file.h"
+#include "common/progress.h"
+#include "common/reuse_distance.h"
+#include "common/run_report.h"
+#include "common/trace_format.h"
+#include "common/trace_record.h"
+
+// Distances of every non-cold request, counted once and weighed by the
+// request's object size.
+struct DistanceProfile {
+  trace::LogLinearHistogram requests;
+  trace::LogLinearHistogram requestBytes;
+  uint64_t totalRequests = 0;
+  uint64_t totalBytes = 0;
+  uint64_t coldMisses = 0;
+  uint64_t coldBytes = 0;
+  uint64_t badLines = 0;
+
+  explicit DistanceProfile(unsigned subBucketBits)
+      : requests(subBucketBits), requestBytes(subBucketBits) {}
+};
+
+// One line per non-empty bin with the cumulative hit ratios of an LRU cache as large
+// as the bin's upper bound.
+void printProfile(std::ostream &out, const DistanceProfile &profile, uint64_t keys,
+                  const std::string &unit) {
+  out << "=== Reuse distance (" << unit << ") ===\n";
+  out << "# requests " << profile.totalRequests << " request_bytes " << profile.totalBytes
+      << " cold_misses " << profile.coldMisses << " cold_bytes " << profile.coldBytes
+      << " keys " << keys << "\n";
+  out << "# lower upper requests request_bytes hit_ratio byte_hit_ratio\n";
+  const trace::LogLinearHistogram &hist = profile.requests;
+  uint64_t hits = 0;
+  uint64_t hitBytes = 0;
+  size_t last = hist.lastNonEmpty();
+  for (size_t i = hist.firstNonEmpty(); i <= last && i < hist.numBuckets(); ++i) {
+    if (hist.count(i) == 0) {
+      continue;
+    }
+    hits += hist.count(i);
+    hitBytes += profile.requestBytes.count(i);
+    out << hist.lowerBound(i) << " " << hist.upperBound(i) << " " << hist.count(i) << " "
+        << profile.requestBytes.count(i) << " "
+        << static_cast<double>(hits) / profile.totalRequests << " "
+        << (profile.totalBytes ? static_cast<double>(hitBytes) / profile.totalBytes : 0.0)
+        << "\n";
+  }
+  out << "\n";
+}
+
+int main(int argc, char *argv[]) {
+  trace::RunReport report("reuse_distance", argc, argv);
+  argparse::ArgumentParser program("reuse_distance", "1.0");
+
+  program.add_argument("input_files")
+      .help("One or more CSV trace files, read as one trace in the given order")
+      .required()
+      .remaining();
+  program.add_argument("-b", "--sub-bucket-bits")
+      .default_value(2u)
+      .scan<'u', unsigned>()
+      .help("Each power of two is split into 2^b bins (0 = plain log2 bins)");
+  program.add_argument("-f", "--format")
+      .default_value(std::string("5col"))
+      .choices("5col", "7col")
+      .help("Input layout");
+  program.add_argument("-w", "--weight")
+      .default_value(std::string("objects"))
+      .choices("objects", "bytes")
+      .help("Measure the distance in distinct objects or in their bytes");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  std::vector<std::string> traceFiles;
+  try {
+    traceFiles = program.get<std::vector<std::string>>("input_files");
+    if (traceFiles.empty()) {
+      std::cerr << "No input files provided.\n";
+      return 1;
+    }
+  } catch (...) {
+    std::cerr << "No input files provided.\n";
+    return 1;
+  }
+
+  unsigned subBucketBits = program.get<unsigned>("--sub-bucket-bits");
+  if (subBucketBits > 16) {
+    std::cerr << "--sub-bucket-bits must be at most 16.\n";
+    return 1;
+  }
+  trace::TraceFormat format = trace::TraceFormat::FiveColumn;
+  trace::parseTraceFormat(program.get<std::string>("--format"), format);
+  bool bytes = program.get<std::string>("--weight") == "bytes";
+
+  // The stack depends on the order of every request, so the trace is read
+  // by one thread.
+  trace::ReuseDistance stack(bytes ? trace::ReuseDistance::Weight::Bytes
+                                   : trace::ReuseDistance::Weight::Objects);
+  DistanceProfile profile(subBucketBits);
+  trace::ProgressReporter progress("reuse_distance", trace::fileBytes(traceFiles));
+  int keysMap = progress.addMap("keys");
+  trace::StageTimer parse(trace::Stage::Parse);
+  trace::StageTimer aggregate(trace::Stage::Aggregate);
+  trace::ProgressReporter::Batch counted(progress);
+  trace::TraceRecord rec;
+  for (const auto &filePath : traceFiles) {
+    trace::MappedFile in;
+    if (!in.open(filePath)) {
+      return 1;
+    }
+    std::string_view body = in.view();
+    if (trace::hasHeader(format)) {
+      body = body.substr(trace::nextLineStart(body, 0));
+    }
+    trace::forEachLine(body, [&](std::string_view line) {
+      counted.add(1, line.size() + 1);
+      {
+        auto timed = parse.time(line.size() + 1);
+        if (!trace::parseRecord(line, format, rec)) {
+          profile.badLines++;
+          return;
+        }
+      }
+      auto timed = aggregate.time();
+      uint64_t distance = stack.access(trace::hashKey(rec.key), rec.objectSize);
+      profile.totalRequests++;
+      profile.totalBytes += rec.objectSize;
+      if (distance == 0) {
+        profile.coldMisses++;
+        profile.coldBytes += rec.objectSize;
+      } else {
+        profile.requests.record(distance);
+        profile.requestBytes.record(distance, rec.objectSize);
+      }
+      if ((profile.totalRequests & ((1u << 18) - 1)) == 0) {
+        progress.publishMap(keysMap, trace::mapHealth(stack.index()));
+      }
+    });
+  }
+
+  printProfile(std::cout, profile, stack.keys(), bytes ? "bytes" : "objects");
+  if (profile.badLines > 0) {
+    std::cerr << "Skipped " << profile.badLines << " malformed lines.\n";
+  }
+
+  return 0;
+}
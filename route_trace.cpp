@@ -0,0 +1,312 @@
+#include "include/argparse/argparse.hpp"
+#include "include/fmt/core.h"
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/buffered_writer.h"
+#include "common/line_scan.h"
+#include "common/mapped_file.h"
+#include "common/progress.h"
+#include "common/run_report.h"
+#include "common/trace_filter.h"
+#include "common/trace_format.h"
+#include "common/trace_record.h"
+
+// ----------------------------------------------------------------
+// Predicates
+//
+// A predicate is a comma separated list of clauses that must all hold,
+// e.g. "op=get|gets,size<=2KB". A clause is <field><cmp><values> with
+//   field  : op, size, key_size, value_size, client_id, time, ttl
+//   cmp    : = != < <= > >=
+//   values : '|' separated alternatives for = and !=; numbers may end in
+//            K/KB, M/MB or G/GB (powers of 1024). "*" matches every row.
+// size is the object size (key + value), as in trace_info.
+// ----------------------------------------------------------------
+enum class Field { Op, Size, KeySize, ValueSize, ClientId, Time, Ttl };
+enum class Cmp { Eq, Ne, Lt, Le, Gt, Ge };
+
+struct Clause {
+  Field field;
+  Cmp cmp;
+  std::vector<std::string> ops;
+  std::vector<uint64_t> numbers;
+};
+
+struct Route {
+  std::string expression;
+  std::vector<Clause> clauses;
+  trace::BufferedWriter output;
+  uint64_t rows = 0;
+};
+
+bool parseField(const std::string &name, Field &field) {
+  if (name == "op") field = Field::Op;
+  else if (name == "size") field = Field::Size;
+  else if (name == "key_size") field = Field::KeySize;
+  else if (name == "value_size") field = Field::ValueSize;
+  else if (name == "client_id") field = Field::ClientId;
+  else if (name == "time") field = Field::Time;
+  else if (name == "ttl") field = Field::Ttl;
+  else return false;
+  return true;
+}
+
+bool parseSize(std::string text, uint64_t &value) {
+  uint64_t scale = 1;
+  while (!text.empty() && (text.back() == 'B' || text.back() == 'b')) {
+    text.pop_back();
+  }
+  if (!text.empty()) {
+    switch (std::toupper(static_cast<unsigned char>(text.back()))) {
+    case 'K': scale = 1ull << 10; text.pop_back(); break;
+    case 'M': scale = 1ull << 20; text.pop_back(); break;
+    case 'G': scale = 1ull << 30; text.pop_back(); break;
+    }
+  }
+  if (!trace::parseNumber(std::string_view(text), value)) {
+    return false;
+  }
+  value *= scale;
+  return true;
+}
+
+// Throws std::runtime_error with a message naming the bad clause.
+std::vector<Clause> parsePredicate(const std::string &expression) {
+  std::vector<Clause> clauses;
+  if (expression == "*") {
+    return clauses;
+  }
+  size_t begin = 0;
+  while (begin <= expression.size()) {
+    size_t end = expression.find(',', begin);
+    if (end == std::string::npos) {
+      end = expression.size();
+    }
+    std::string text = expression.substr(begin, end - begin);
+    begin = end + 1;
+
+    size_t opPos = text.find_first_of("=!<>");
+    if (opPos == std::string::npos || opPos == 0) {
+      throw std::runtime_error(fmt::format("Bad clause '{}'", text));
+    }
+    Clause clause;
+    if (!parseField(text.substr(0, opPos), clause.field)) {
+      throw std::runtime_error(
+          fmt::format("Unknown field '{}'", text.substr(0, opPos)));
+    }
+    std::string cmp = text.substr(opPos, text.find_first_not_of("=!<>", opPos) - opPos);
+    if (cmp == "=" || cmp == "==") clause.cmp = Cmp::Eq;
+    else if (cmp == "!=") clause.cmp = Cmp::Ne;
+    else if (cmp == "<") clause.cmp = Cmp::Lt;
+    else if (cmp == "<=") clause.cmp = Cmp::Le;
+    else if (cmp == ">") clause.cmp = Cmp::Gt;
+    else if (cmp == ">=") clause.cmp = Cmp::Ge;
+    else throw std::runtime_error(fmt::format("Bad comparison in '{}'", text));
+
+    std::string values = text.substr(opPos + cmp.size());
+    bool equality = clause.cmp == Cmp::Eq || clause.cmp == Cmp::Ne;
+    if (clause.field == Field::Op && !equality) {
+      throw std::runtime_error(fmt::format("op only supports = and != in '{}'", text));
+    }
+    size_t vbegin = 0;
+    while (vbegin <= values.size()) {
+      size_t vend = values.find('|', vbegin);
+      if (vend == std::string::npos) {
+        vend = values.size();
+      }
+      std::string value = values.substr(vbegin, vend - vbegin);
+      vbegin = vend + 1;
+      if (clause.field == Field::Op) {
+        clause.ops.push_back(value);
+        continue;
+      }
+      uint64_t number = 0;
+      if (!parseSize(value, number)) {
+        throw std::runtime_error(fmt::format("Bad number '{}' in '{}'", value, text));
+      }
+      clause.numbers.push_back(number);
+    }
+    if (!equality && clause.numbers.size() != 1) {
+      throw std::runtime_error(fmt::format("'{}' needs exactly one value", text));
+    }
+    clauses.push_back(std::move(clause));
+  }
+  return clauses;
+}
+
+uint64_t fieldValue(const trace::TraceRecord &rec, Field field) {
+  switch (field) {
+  case Field::Size: return rec.objectSize;
+  case Field::KeySize: return rec.keySize;
+  case Field::ValueSize: return rec.valueSize;
+  case Field::ClientId: return rec.clientId;
+  case Field::Time: return rec.timestamp;
+  case Field::Ttl: return rec.ttl;
+  case Field::Op: break;
+  }
+  return 0;
+}
+
+bool matches(const Clause &clause, const trace::TraceRecord &rec) {
+  if (clause.field == Field::Op) {
+    bool any = false;
+    for (const auto &op : clause.ops) {
+      any |= rec.op == op;
+    }
+    return any == (clause.cmp == Cmp::Eq);
+  }
+  uint64_t value = fieldValue(rec, clause.field);
+  switch (clause.cmp) {
+  case Cmp::Eq:
+  case Cmp::Ne: {
+    bool any = false;
+    for (uint64_t number : clause.numbers) {
+      any |= value == number;
+    }
+    return any == (clause.cmp == Cmp::Eq);
+  }
+  case Cmp::Lt: return value < clause.numbers[0];
+  case Cmp::Le: return value <= clause.numbers[0];
+  case Cmp::Gt: return value > clause.numbers[0];
+  case Cmp::Ge: return value >= clause.numbers[0];
+  }
+  return false;
+}
+
+bool matches(const std::vector<Clause> &clauses, const trace::TraceRecord &rec) {
+  for (const auto &clause : clauses) {
+    if (!matches(clause, rec)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  trace::RunReport report("route_trace", argc, argv);
+  argparse::ArgumentParser options("route_trace");
+
+  options.add_argument("-i", "--input")
+      .required()
+      .help("Trace file to route");
+  options.add_argument("-r", "--route")
+      .nargs(2)
+      .append()
+      .required()
+      .help("PREDICATE OUTPUT: write rows matching PREDICATE to OUTPUT; "
+            "repeatable, e.g. -r 'size<=2KB' under.csv -r 'op=delete' del.csv");
+  options.add_argument("-f", "--format")
+      .default_value(std::string("5col"))
+      .choices("5col", "7col")
+      .help("Input layout; client_id, time and ttl need 7col");
+  options.add_argument("--preprocess")
+      .flag()
+      .help("Drop rows preprocess_trace would drop (non get/gets/delete, "
+            "reads of empty values) before routing");
+
+  try {
+    options.parse_args(argc, argv);
+  } catch (const std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << options;
+    return 1;
+  }
+
+  trace::TraceFormat format = trace::TraceFormat::FiveColumn;
+  trace::parseTraceFormat(options.get<std::string>("--format"), format);
+  bool preprocess = options.get<bool>("--preprocess");
+
+  auto routeArgs = options.get<std::vector<std::string>>("--route");
+  std::vector<Route> routes(routeArgs.size() / 2);
+  try {
+    for (size_t i = 0; i < routes.size(); ++i) {
+      routes[i].expression = routeArgs[2 * i];
+      routes[i].clauses = parsePredicate(routes[i].expression);
+      for (const auto &clause : routes[i].clauses) {
+        bool sevenColumnOnly = clause.field == Field::ClientId ||
+                               clause.field == Field::Time ||
+                               clause.field == Field::Ttl;
+        if (sevenColumnOnly && format != trace::TraceFormat::SevenColumn) {
+          throw std::runtime_error(fmt::format(
+              "'{}' uses a field only the 7col format has", routes[i].expression));
+        }
+      }
+    }
+  } catch (const std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    return 1;
+  }
+
+  trace::MappedFile in;
+  if (!in.open(options.get<std::string>("--input"))) {
+    return 1;
+  }
+  std::string_view body = in.view();
+  std::string_view header;
+  if (trace::hasHeader(format)) {
+    header = body.substr(0, trace::nextLineStart(body, 0));
+    body = body.substr(header.size());
+  }
+  for (size_t i = 0; i < routes.size(); ++i) {
+    if (!routes[i].output.open(routeArgs[2 * i + 1])) {
+      return 1;
+    }
+    if (!header.empty()) {
+      routes[i].output.appendLine(header);
+    }
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  uint64_t numLines = 0;
+  uint64_t skippedLines = 0;
+  trace::TraceRecord rec;
+  trace::StageTimer parse(trace::Stage::Parse);
+  trace::StageTimer filter(trace::Stage::Filter);
+  trace::StageTimer write(trace::Stage::Write);
+  trace::ProgressReporter progress("route_trace", body.size());
+  trace::ProgressReporter::Batch counted(progress);
+  trace::forEachLine(body, [&](std::string_view line) {
+    numLines++;
+    counted.add(1, line.size() + 1);
+    {
+      auto timed = parse.time(line.size() + 1);
+      if (!trace::parseRecord(line, format, rec)) {
+        skippedLines++;
+        return;
+      }
+    }
+    if (preprocess) {
+      auto timed = filter.time();
+      if (!trace::keepRow(rec.op, rec.valueSize)) {
+        skippedLines++;
+        return;
+      }
+    }
+    // Matching is a few compares; the appends dominate.
+    auto timed = write.time(line.size() + 1);
+    for (auto &route : routes) {
+      if (matches(route.clauses, rec)) {
+        route.output.appendLine(line);
+        route.rows++;
+      }
+    }
+  });
+
+  for (auto &route : routes) {
+    route.output.close();
+    std::cout << fmt::format("{} <- '{}': {} lines", route.output.path(),
+                             route.expression, route.rows)
+              << std::endl;
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = end - start;
+  std::cout << fmt::format("total processed lines: {} ({} skipped, {:.2f} MB/s)",
+                           numLines, skippedLines,
+                           in.size() / 1e6 / elapsed.count())
+            << std::endl;
+  return 0;
+}
@@ -1,64 +1,531 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
-#include <random>
+#include <queue>
 #include <string>
+#include <thread>
+#include <vector>
 
-void sampleTraceFile(const std::string& inputFile, const std::string& outputFile, int n) {
-    std::ifstream inFile(inputFile);
-    std::ofstream outFile(outputFile);
+#include "include/argparse/argparse.hpp"
+#include "include/robin_hood/robin_hood.h"
+#include "common/key_hash.h"
+#include "common/line_scan.h"
+#include "common/mapped_file.h"
+#include "common/philox.h"
+#include "common/progress.h"
+#include "common/run_report.h"
+#include "common/trace_format.h"
 
-    if (!inFile.is_open() || !outFile.is_open()) {
+// Input is processed in rounds of `threads` blocks of this size, so memory
+// stays bounded while every worker has a large contiguous range.
+static const size_t BLOCK_BYTES = 64ull << 20;
+
+// One requested sample: keep 1/n of the input and write it to `path`.
+struct SampleTarget {
+    uint64_t n;
+    std::string path;
+};
+
+// One worker's share of a round.
+struct Block {
+    std::string_view text;  // starts at a line boundary
+    uint64_t firstLine;     // global index of the first line in `text`
+    uint64_t cutLine;       // lines from here on belong to the next round
+    uint64_t endLine;       // one past the last line read so far
+    bool lastRound;         // `endLine` is the total number of lines
+};
+
+void appendLine(std::string& out, std::string_view line) {
+    out.append(line.data(), line.size());
+    if (line.empty() || line.back() != '\n') {
+        out.push_back('\n');
+    }
+}
+
+// ----------------------------------------------------------------
+// Streams the mapped input through `threads` workers and writes each
+// block's output in input order, to every output file in one pass.
+//
+// When windowLines > 0 every block learns the global index of its first
+// line (one extra counting pass over the round, in parallel), and a round
+// only ever ends on a multiple of windowLines so no window is split between
+// rounds. sampleBlock(worker, block, outs) appends the kept lines to
+// outs[i] for output i and returns the offset of `block.cutLine` inside the
+// block if it stopped there, or std::string_view::npos.
+// ----------------------------------------------------------------
+template <typename BlockFn>
+void streamBlocks(std::string_view text, std::vector<std::ofstream>& outFiles,
+                  unsigned threads, uint64_t windowLines, BlockFn&& sampleBlock) {
+    size_t pos = 0;
+    uint64_t firstLine = 0;
+    size_t roundBytes = BLOCK_BYTES * threads;
+    trace::StageTimer write(trace::Stage::Write);
+    trace::ProgressReporter progress("sampling", text.size());
+    std::vector<std::vector<std::string>> outputs(
+        threads, std::vector<std::string>(outFiles.size()));
+
+    while (pos < text.size()) {
+        size_t roundEnd = roundBytes >= text.size() - pos
+                              ? text.size()
+                              : trace::nextLineStart(text, pos + roundBytes - 1);
+        std::string_view round = text.substr(pos, roundEnd - pos);
+        bool lastRound = roundEnd == text.size();
+        std::vector<size_t> bounds = trace::splitAtLines(round, threads);
+
+        std::vector<uint64_t> blockFirst(threads + 1, 0);
+        uint64_t endLine = firstLine;
+        uint64_t cutLine = firstLine;
+        if (windowLines > 0) {
+            trace::parallelFor(threads, [&](size_t t) {
+                trace::StageTimer read(trace::Stage::Read);
+                auto timed = read.block();
+                blockFirst[t + 1] =
+                    trace::countLines(round.substr(bounds[t], bounds[t + 1] - bounds[t]));
+                read.count(blockFirst[t + 1], bounds[t + 1] - bounds[t]);
+            });
+            for (unsigned t = 0; t < threads; ++t) {
+                blockFirst[t + 1] += blockFirst[t];
+            }
+            endLine = firstLine + blockFirst[threads];
+            cutLine = lastRound ? endLine : endLine / windowLines * windowLines;
+            if (cutLine <= firstLine) {
+                roundBytes *= 2;  // Not even one whole window; read further.
+                continue;
+            }
+        }
+
+        std::vector<size_t> cutOffsets(threads, std::string_view::npos);
+        trace::parallelFor(threads, [&](size_t t) {
+            for (auto& out : outputs[t]) {
+                out.clear();
+            }
+            Block block{round.substr(bounds[t], bounds[t + 1] - bounds[t]),
+                        firstLine + blockFirst[t], cutLine, endLine, lastRound};
+            trace::StageTimer filter(trace::Stage::Filter);
+            auto timed = filter.block();
+            cutOffsets[t] = sampleBlock(t, block, outputs[t]);
+            filter.count(0, block.text.size());
+        });
+        {
+            auto timed = write.block();
+            for (const auto& outs : outputs) {
+                for (size_t i = 0; i < outs.size(); ++i) {
+                    outFiles[i].write(outs[i].data(), outs[i].size());
+                    write.count(0, outs[i].size());
+                }
+            }
+        }
+
+        size_t next = roundEnd;
+        if (windowLines > 0 && !lastRound) {
+            for (unsigned t = 0; t < threads; ++t) {
+                if (cutOffsets[t] != std::string_view::npos) {
+                    next = pos + bounds[t] + cutOffsets[t];
+                    break;
+                }
+            }
+        }
+        progress.add(cutLine - firstLine, next - pos);
+        pos = next;
+        firstLine = cutLine;
+    }
+}
+
+// Opens one output file per target. Prints an error and returns false if
+// any of them cannot be opened.
+bool openOutputs(const std::vector<SampleTarget>& targets,
+                 std::vector<std::ofstream>& outFiles) {
+    for (const auto& target : targets) {
+        outFiles.emplace_back(target.path, std::ios::binary);
+        if (!outFiles.back().is_open()) {
+            std::cerr << "Error: Unable to open output file " << target.path << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes the header line to every output and returns the rest of the input.
+std::string_view copyHeader(std::string_view text, std::vector<std::ofstream>& outFiles) {
+    size_t headerEnd = trace::nextLineStart(text, 0);
+    if (headerEnd > 0) {
+        std::string header;
+        appendLine(header, text.substr(0, headerEnd));
+        for (auto& outFile : outFiles) {
+            outFile.write(header.data(), header.size()); // 헤더 유지
+        }
+    }
+    return text.substr(headerEnd);
+}
+
+// ----------------------------------------------------------------
+// Random sampling: one line per n lines.
+//
+// The kept line of window w is a pure function of (seed, n, w) through the
+// Philox generator, so the output is the same for every thread count and
+// every run with the same seed. Lines that are not kept are skipped
+// without being copied.
+//
+// Several rates are nested: with n sorted ascending and each n dividing the
+// next, a window first keeps the line its enclosing coarser window kept, if
+// it has it, and draws its own line otherwise. Every line is still kept with
+// probability 1/n, exactly one per window, and each sample is a subset of
+// every finer one.
+// ----------------------------------------------------------------
+class WindowPicker {
+public:
+    // `ns` must be ascending, each value dividing the next.
+    WindowPicker(std::vector<uint64_t> ns, uint64_t seed) : ns_(std::move(ns)), rng_(seed) {}
+
+    size_t levels() const { return ns_.size(); }
+    uint64_t n(size_t level) const { return ns_[level]; }
+
+    // Index of the line kept by `window` of `level`. The last window is
+    // short when the input does not end on a multiple of n.
+    uint64_t selected(size_t level, uint64_t window, const Block& block) const {
+        uint64_t n = ns_[level];
+        uint64_t windowStart = window * n;
+        uint64_t windowSize = n;
+        if (block.lastRound && windowStart + n > block.endLine) {
+            windowSize = block.endLine - windowStart;
+        }
+        if (level + 1 < ns_.size()) {
+            uint64_t parent = selected(level + 1, windowStart / ns_[level + 1], block);
+            if (parent >= windowStart && parent < windowStart + windowSize) {
+                return parent;
+            }
+        }
+        return windowStart + rng_.below(n, window, windowSize);
+    }
+
+    // Index of the first line at or after `line` kept by the finest level,
+    // or block.endLine when no window of the input has one.
+    uint64_t nextSelected(uint64_t line, const Block& block) const {
+        uint64_t window = line / ns_[0];
+        while (true) {
+            if (block.lastRound && window * ns_[0] >= block.endLine) {
+                return block.endLine;
+            }
+            uint64_t sel = selected(0, window, block);
+            if (sel >= line) {
+                return sel;
+            }
+            window++;
+        }
+    }
+
+private:
+    std::vector<uint64_t> ns_;
+    trace::Philox4x32 rng_;
+};
+
+// `outputOf[level]` is the output index of each picker level.
+size_t sampleRandomBlock(const WindowPicker& picker, const std::vector<size_t>& outputOf,
+                         const Block& block, std::vector<std::string>& outs) {
+    size_t pos = 0;
+    uint64_t line = block.firstLine;
+    while (line < block.cutLine && pos < block.text.size()) {
+        uint64_t stop = std::min(picker.nextSelected(line, block), block.cutLine);
+        while (line < stop && pos < block.text.size()) {
+            pos = trace::nextLineStart(block.text, pos);
+            line++;
+        }
+        if (line == block.cutLine || pos >= block.text.size()) {
+            break;
+        }
+        size_t end = trace::nextLineStart(block.text, pos);
+        std::string_view kept = block.text.substr(pos, end - pos);
+        appendLine(outs[outputOf[0]], kept);
+        for (size_t level = 1; level < picker.levels(); ++level) {
+            if (picker.selected(level, line / picker.n(level), block) != line) {
+                break;  // Coarser samples are subsets of this one.
+            }
+            appendLine(outs[outputOf[level]], kept);
+        }
+        pos = end;
+        line++;
+    }
+    if (line == block.cutLine && pos < block.text.size()) {
+        return pos;
+    }
+    return std::string_view::npos;
+}
+
+void sampleTraceFile(const std::string& inputFile, const std::vector<SampleTarget>& targets,
+                     trace::TraceFormat format, uint64_t seed, unsigned threads) {
+    trace::MappedFile in;
+    std::vector<std::ofstream> outFiles;
+
+    if (!in.open(inputFile) || !openOutputs(targets, outFiles)) {
         std::cerr << "Error: Unable to open input or output file." << std::endl;
         return;
     }
 
-    std::string header;
-    if (std::getline(inFile, header)) {
-        outFile << header << "\n"; // 헤더 유지
+    std::vector<size_t> outputOf(targets.size());
+    for (size_t i = 0; i < targets.size(); ++i) {
+        outputOf[i] = i;
     }
+    std::sort(outputOf.begin(), outputOf.end(),
+              [&](size_t a, size_t b) { return targets[a].n < targets[b].n; });
+    std::vector<uint64_t> ns;
+    for (size_t i : outputOf) {
+        ns.push_back(targets[i].n);
+    }
+
+    std::string_view body = in.view();
+    if (trace::hasHeader(format)) {
+        body = copyHeader(body, outFiles);
+    }
+    WindowPicker picker(ns, seed);
+    streamBlocks(body, outFiles, threads, ns.back(),
+                 [&](size_t, const Block& block, std::vector<std::string>& outs) {
+                     return sampleRandomBlock(picker, outputOf, block, outs);
+                 });
+
+    for (size_t i = 0; i < targets.size(); ++i) {
+        outFiles[i].close();
+        std::cout << "Sampling complete. Output saved to: " << targets[i].path << std::endl;
+    }
+}
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dist(0, n - 1);
+// ----------------------------------------------------------------
+// Spatial (SHARDS-style) sampling: keep every request of the keys whose
+// hash is at or below a limit, so per-key reuse patterns survive.
+// ----------------------------------------------------------------
 
-    std::string line;
-    std::vector<std::string> buffer;
-    
-    while (std::getline(inFile, line)) {
-        buffer.push_back(line);
-        if (buffer.size() == n) {
-            int randIdx = dist(gen);  // 0 ~ (n-1) 중 랜덤으로 하나 선택
-            outFile << buffer[randIdx] << "\n";  // 무조건 하나 출력
-            buffer.clear();  // 버퍼 초기화
+// Keeps the maxKeys smallest distinct hashes at or below `limit`, lowering
+// `limit` to the largest of them once the budget is full.
+struct SmallestHashes {
+    uint64_t limit;
+    std::priority_queue<uint64_t> largest;
+    robin_hood::unordered_flat_set<uint64_t> sampled;
+
+    void add(uint64_t h, uint64_t maxKeys) {
+        if (h > limit || !sampled.insert(h).second) {
+            return;
+        }
+        largest.push(h);
+        if (sampled.size() > maxKeys) {
+            sampled.erase(largest.top());
+            largest.pop();
+            limit = largest.top();
         }
     }
+};
+
+// Finds the hash limit that keeps at most maxKeys distinct keys (never more
+// than the 1/n rate). Each worker keeps the smallest hashes of its part and
+// the parts are merged the same way, so memory is O(threads * maxKeys).
+uint64_t findFixedSizeLimit(const std::string& inputFile, trace::TraceFormat format,
+                            uint64_t n, uint64_t maxKeys, unsigned threads) {
+    trace::MappedFile in;
+    if (!in.open(inputFile)) {
+        return trace::hashLimitForRatio(n);
+    }
+    std::string_view body = in.view();
+    if (trace::hasHeader(format)) {
+        body = body.substr(trace::nextLineStart(body, 0));
+    }
+
+    std::vector<SmallestHashes> parts(threads);
+    std::vector<size_t> bounds = trace::splitAtLines(body, threads);
+    trace::parallelFor(threads, [&](size_t t) {
+        parts[t].limit = trace::hashLimitForRatio(n);
+        trace::StageTimer hash(trace::Stage::Hash);
+        std::string keyBuffer;
+        trace::forEachLine(body.substr(bounds[t], bounds[t + 1] - bounds[t]),
+                           [&](std::string_view line) {
+                               auto timed = hash.time(line.size() + 1);
+                               parts[t].add(
+                                   trace::hashKey(trace::keyField(line, format, keyBuffer)),
+                                   maxKeys);
+                           });
+    });
+
+    // A part that filled its budget already proves the global limit is no
+    // higher than its own, and it kept every hash below that.
+    SmallestHashes merged;
+    merged.limit = trace::hashLimitForRatio(n);
+    for (const auto& part : parts) {
+        merged.limit = std::min(merged.limit, part.limit);
+    }
+    for (auto& part : parts) {
+        for (uint64_t h : part.sampled) {
+            merged.add(h, maxKeys);
+        }
+    }
+    return merged.limit;
+}
+
+// limits[i] is the hash limit of targets[i]. Nested rates come for free:
+// a key under a lower limit is also under every higher one.
+void spatialSampleTraceFile(const std::string& inputFile, const std::vector<SampleTarget>& targets,
+                            const std::vector<uint64_t>& limits, trace::TraceFormat format,
+                            unsigned threads) {
+    trace::MappedFile in;
+    std::vector<std::ofstream> outFiles;
+
+    if (!in.open(inputFile) || !openOutputs(targets, outFiles)) {
+        std::cerr << "Error: Unable to open input or output file." << std::endl;
+        return;
+    }
 
-    // 마지막 남은 데이터가 있다면 한 개 랜덤 선택
-    if (!buffer.empty()) {
-        std::uniform_int_distribution<int> lastDist(0, buffer.size() - 1);
-        outFile << buffer[lastDist(gen)] << "\n";
+    std::string_view body = in.view();
+    if (trace::hasHeader(format)) {
+        body = copyHeader(body, outFiles);
     }
 
-    inFile.close();
-    outFile.close();
+    std::vector<uint64_t> totalLines(threads, 0);
+    std::vector<std::vector<uint64_t>> sampledLines(threads,
+                                                    std::vector<uint64_t>(targets.size(), 0));
+    streamBlocks(body, outFiles, threads, 0,
+                 [&](size_t t, const Block& block, std::vector<std::string>& outs) {
+                     std::string keyBuffer;
+                     trace::forEachLine(block.text, [&](std::string_view line) {
+                         totalLines[t]++;
+                         uint64_t h = trace::hashKey(trace::keyField(line, format, keyBuffer));
+                         for (size_t i = 0; i < limits.size(); ++i) {
+                             if (h <= limits[i]) {
+                                 appendLine(outs[i], line);
+                                 sampledLines[t][i]++;
+                             }
+                         }
+                     });
+                     return std::string_view::npos;
+                 });
 
-    std::cout << "Sampling complete. Output saved to: " << outputFile << std::endl;
+    uint64_t total = 0;
+    for (unsigned t = 0; t < threads; ++t) {
+        total += totalLines[t];
+    }
+    for (size_t i = 0; i < targets.size(); ++i) {
+        outFiles[i].close();
+        uint64_t sampled = 0;
+        for (unsigned t = 0; t < threads; ++t) {
+            sampled += sampledLines[t][i];
+        }
+        std::cout << "Sampled " << sampled << " of " << total << " lines at key rate "
+                  << trace::hashLimitRate(limits[i]) << " (hash limit " << limits[i] << ")"
+                  << std::endl;
+        std::cout << "Sampling complete. Output saved to: " << targets[i].path << std::endl;
+    }
 }
+
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        std::cerr << "Usage: " << argv[0] << " <input_file> <output_file> <n>" << std::endl;
+    trace::RunReport report("sampling", argc, argv);
+    argparse::ArgumentParser program("sampling");
+
+    program.add_argument("input_file");
+    program.add_argument("output_file");
+    program.add_argument("n")
+        .scan<'i', int>()
+        .help("Keep 1/n of the lines (random) or of the keys (shards modes)");
+    program.add_argument("-m", "--mode")
+        .default_value(std::string("random"))
+        .choices("random", "shards", "shards-fixed-size")
+        .help("random: one random line per n lines; shards: every request of "
+              "keys hashed under 1/n; shards-fixed-size: like shards, with the "
+              "rate lowered so at most --max-keys keys are kept");
+    program.add_argument("--max-keys")
+        .scan<'u', uint64_t>()
+        .help("Distinct key budget for shards-fixed-size");
+    program.add_argument("-f", "--format")
+        .default_value(std::string("5col"))
+        .choices("5col", "7col")
+        .help("Input layout; decides the key column and whether there is a header");
+    program.add_argument("-s", "--seed")
+        .default_value(uint64_t{0})
+        .scan<'u', uint64_t>()
+        .help("Seed of the random mode; equal seeds give identical samples");
+    program.add_argument("--fanout")
+        .nargs(2)
+        .append()
+        .help("N OUTPUT: also write a 1/N sample to OUTPUT from the same read; "
+              "repeatable. Samples are nested: a sparser one is a subset of a "
+              "denser one (random mode needs each N to divide the next)");
+    program.add_argument("-t", "--threads")
+        .default_value(std::max(1u, std::thread::hardware_concurrency()))
+        .scan<'u', unsigned>()
+        .help("Worker threads; the output does not depend on this");
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::exception& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << program;
         return 1;
     }
-    
-    std::string inputFile = argv[1];
-    std::string outputFile = argv[2];
-    int n = std::stoi(argv[3]);
-    
+
+    std::string inputFile = program.get<std::string>("input_file");
+    std::string outputFile = program.get<std::string>("output_file");
+    int n = program.get<int>("n");
+    unsigned threads = std::max(1u, program.get<unsigned>("--threads"));
+
     if (n <= 0) {
         std::cerr << "Error: n must be a positive integer." << std::endl;
         return 1;
     }
-    
-    sampleTraceFile(inputFile, outputFile, n);
+
+    trace::TraceFormat format = trace::TraceFormat::FiveColumn;
+    trace::parseTraceFormat(program.get<std::string>("--format"), format);
+
+    std::vector<SampleTarget> targets = {{static_cast<uint64_t>(n), outputFile}};
+    if (program.is_used("--fanout")) {
+        auto fanout = program.get<std::vector<std::string>>("--fanout");
+        for (size_t i = 0; i + 1 < fanout.size(); i += 2) {
+            uint64_t rate = 0;
+            try {
+                rate = std::stoull(fanout[i]);
+            } catch (const std::exception&) {
+            }
+            if (rate == 0) {
+                std::cerr << "Error: --fanout rate must be a positive integer: " << fanout[i]
+                          << std::endl;
+                return 1;
+            }
+            targets.push_back({rate, fanout[i + 1]});
+        }
+    }
+
+    auto mode = program.get<std::string>("--mode");
+    if (mode == "random") {
+        std::vector<uint64_t> ns;
+        for (const auto& target : targets) {
+            ns.push_back(target.n);
+        }
+        std::sort(ns.begin(), ns.end());
+        for (size_t i = 1; i < ns.size(); ++i) {
+            if (ns[i] % ns[i - 1] != 0) {
+                std::cerr << "Error: random mode nests samples only when each n divides the "
+                          << "next (" << ns[i - 1] << " does not divide " << ns[i] << ")."
+                          << std::endl;
+                return 1;
+            }
+        }
+        sampleTraceFile(inputFile, targets, format, program.get<uint64_t>("--seed"), threads);
+    } else if (mode == "shards") {
+        std::vector<uint64_t> limits;
+        for (const auto& target : targets) {
+            limits.push_back(trace::hashLimitForRatio(target.n));
+        }
+        spatialSampleTraceFile(inputFile, targets, limits, format, threads);
+    } else {
+        if (!program.is_used("--max-keys")) {
+            std::cerr << "Error: shards-fixed-size needs --max-keys." << std::endl;
+            return 1;
+        }
+        if (targets.size() > 1) {
+            std::cerr << "Error: shards-fixed-size writes a single sample; drop --fanout."
+                      << std::endl;
+            return 1;
+        }
+        uint64_t maxKeys = program.get<uint64_t>("--max-keys");
+        if (maxKeys == 0) {
+            std::cerr << "Error: --max-keys must be positive." << std::endl;
+            return 1;
+        }
+        uint64_t limit = findFixedSizeLimit(inputFile, format, n, maxKeys, threads);
+        spatialSampleTraceFile(inputFile, targets, {limit}, format, threads);
+    }
     return 0;
 }
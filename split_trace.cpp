@@ -1,11 +1,27 @@
 #include "include/argparse/argparse.hpp"
 #include "include/csv/csv.h"
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include "include/fmt/core.h"
 #include <fstream>
+#include <sys/sendfile.h>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
+#include "common/buffered_writer.h"
+#include "common/csv_source.h"
+#include "common/key_hash.h"
+#include "common/line_scan.h"
+#include "common/mapped_file.h"
+#include "common/progress.h"
+#include "common/run_report.h"
+#include "common/trace_format.h"
+
 struct Row {
   std::string key;
   std::string op;
@@ -14,7 +30,240 @@ struct Row {
   uint32_t key_size;
 };
 
+// Copies [offset, offset + length) of inFd to the current position of outFd
+// inside the kernel. Falls back from copy_file_range to sendfile to plain
+// pread/write when the file systems do not support the faster call.
+bool copyRange(int inFd, int outFd, off_t offset, size_t length) {
+  loff_t inOffset = offset;
+  while (length > 0) {
+    ssize_t copied = copy_file_range(inFd, &inOffset, outFd, nullptr, length, 0);
+    if (copied > 0) {
+      length -= copied;
+    } else if (copied < 0 && errno == EINTR) {
+      continue;
+    } else {
+      break;
+    }
+  }
+  off_t sendOffset = inOffset;
+  while (length > 0) {
+    ssize_t copied = sendfile(outFd, inFd, &sendOffset, length);
+    if (copied > 0) {
+      length -= copied;
+    } else if (copied < 0 && errno == EINTR) {
+      continue;
+    } else {
+      break;
+    }
+  }
+  std::vector<char> buffer(length > 0 ? 1 << 20 : 0);
+  while (length > 0) {
+    ssize_t got = pread(inFd, buffer.data(), std::min(buffer.size(), length),
+                        sendOffset);
+    if (got <= 0) {
+      return false;
+    }
+    for (ssize_t done = 0; done < got;) {
+      ssize_t put = write(outFd, buffer.data() + done, got - done);
+      if (put < 0) {
+        return false;
+      }
+      done += put;
+    }
+    sendOffset += got;
+    length -= got;
+  }
+  return true;
+}
+
+// Splits without parsing: newline boundaries are found with 64-byte SIMD
+// newline counting (one counting and one locating pass, both parallel), then
+// each part is copied as a byte range with copy_file_range, parts in
+// parallel, after the input's own header line (7col input has none).
+int splitByByteRange(const std::string &traceFilePath,
+                     const std::string &outputPrefix, uint64_t targetNumLines,
+                     trace::TraceFormat format, unsigned threads) {
+  auto start = std::chrono::high_resolution_clock::now();
+
+  trace::MappedFile in;
+  if (!in.open(traceFilePath)) {
+    return 1;
+  }
+  std::string_view text = in.view();
+  size_t headerEnd = 0;
+  std::string header;
+  if (trace::hasHeader(format)) {
+    headerEnd = trace::nextLineStart(text, 0);
+    header.assign(text.substr(0, headerEnd));
+    if (header.empty() || header.back() != '\n') {
+      header.push_back('\n');
+    }
+  }
+  std::string_view body = text.substr(headerEnd);
+  trace::StageTimer scan(trace::Stage::Read);
+  trace::StageTimer copy(trace::Stage::Write);
+  auto scanned = scan.block();
+
+  // Count newlines of equal byte pieces, then turn the counts into the
+  // global index of each piece's first newline.
+  std::vector<size_t> pieceStart(threads + 1, body.size());
+  for (unsigned t = 0; t < threads; ++t) {
+    pieceStart[t] = body.size() / threads * t;
+  }
+  std::vector<uint64_t> firstNewline(threads + 1, 0);
+  trace::parallelFor(threads, [&](size_t t) {
+    firstNewline[t + 1] = trace::countNewlines(
+        body.data() + pieceStart[t], pieceStart[t + 1] - pieceStart[t]);
+  });
+  for (unsigned t = 0; t < threads; ++t) {
+    firstNewline[t + 1] += firstNewline[t];
+  }
+  uint64_t numLines = firstNewline[threads];
+  if (!body.empty() && body.back() != '\n') {
+    numLines++;
+  }
+  uint64_t numFiles = (numLines + targetNumLines - 1) / targetNumLines;
+
+  // Part k > 0 starts after newline k * targetNumLines - 1.
+  std::vector<size_t> partStart(numFiles + 1, body.size());
+  if (numFiles > 0) {
+    partStart[0] = 0;
+  }
+  trace::parallelFor(threads, [&](size_t t) {
+    uint64_t k = std::max<uint64_t>(
+        1, (firstNewline[t] + targetNumLines) / targetNumLines);
+    size_t pos = pieceStart[t];
+    uint64_t newlineAtPos = firstNewline[t];
+    for (; k < numFiles && k * targetNumLines - 1 < firstNewline[t + 1]; ++k) {
+      uint64_t nth = k * targetNumLines - 1 - newlineAtPos;
+      size_t found = pos + trace::findNthNewline(body.data() + pos,
+                                                 pieceStart[t + 1] - pos, nth);
+      partStart[k] = found + 1;
+      pos = found + 1;
+      newlineAtPos = k * targetNumLines;
+    }
+  });
+
+  scanned.stop();
+  scan.count(numLines, body.size());
+  auto copied = copy.block();
+
+  int inFd = open(traceFilePath.c_str(), O_RDONLY);
+  if (inFd < 0) {
+    std::cerr << fmt::format("Cannot open {}: {}", traceFilePath,
+                             std::strerror(errno))
+              << std::endl;
+    return 1;
+  }
+  std::atomic<uint64_t> nextPart{0};
+  std::atomic<bool> failed{false};
+  trace::parallelFor(threads, [&](size_t) {
+    for (uint64_t k = nextPart++; k < numFiles; k = nextPart++) {
+      auto outputFileName = fmt::format("./{}_{}.csv", outputPrefix, k);
+      int outFd = open(outputFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      bool ok = outFd >= 0 &&
+                write(outFd, header.data(), header.size()) ==
+                    static_cast<ssize_t>(header.size()) &&
+                copyRange(inFd, outFd, headerEnd + partStart[k],
+                          partStart[k + 1] - partStart[k]);
+      if (outFd >= 0) {
+        close(outFd);
+      }
+      if (!ok) {
+        std::cerr << fmt::format("Failed to write {}: {}", outputFileName,
+                                 std::strerror(errno))
+                  << std::endl;
+        failed = true;
+      }
+    }
+  });
+  close(inFd);
+  copied.stop();
+  copy.count(numLines, body.size() + numFiles * header.size());
+
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = end - start;
+  std::cout << fmt::format("total processed lines: {} in {} files ({:.2f} MB/s)",
+                           numLines, numFiles,
+                           text.size() / 1e6 / elapsed.count())
+            << std::endl;
+  return failed ? 1 : 0;
+}
+
+// Routes every row to ./<prefix>_part<i>.csv with i = hashKey(key) % N, so
+// all requests of a key land in the same shard and per-key analyses can run
+// on the shards independently. The modulo uses the low hash bits, which
+// keeps the shards independent of the SHARDS sampling threshold (high bits).
+int splitByKeyHash(const std::string &traceFilePath,
+                   const std::string &outputPrefix, uint32_t partitions,
+                   trace::TraceFormat format) {
+  auto start = std::chrono::high_resolution_clock::now();
+
+  trace::MappedFile in;
+  if (!in.open(traceFilePath)) {
+    return 1;
+  }
+  std::string_view body = in.view();
+  std::string_view header;
+  if (trace::hasHeader(format)) {
+    header = body.substr(0, trace::nextLineStart(body, 0));
+    body = body.substr(header.size());
+  }
+
+  // Keep all buffers together around 256 MB, but never below 64 KB each.
+  size_t bufferBytes = std::max<size_t>(64 << 10, (256u << 20) / partitions);
+  std::vector<trace::BufferedWriter> outputs;
+  outputs.reserve(partitions);
+  for (uint32_t i = 0; i < partitions; ++i) {
+    outputs.emplace_back(bufferBytes);
+    if (!outputs.back().open(
+            fmt::format("./{}_part{}.csv", outputPrefix, i))) {
+      return 1;
+    }
+    if (!header.empty()) {
+      outputs.back().appendLine(header);
+    }
+  }
+
+  std::vector<uint64_t> rows(partitions, 0);
+  trace::StageTimer hash(trace::Stage::Hash);
+  trace::StageTimer write(trace::Stage::Write);
+  trace::ProgressReporter progress("split_trace", body.size());
+  trace::ProgressReporter::Batch counted(progress);
+  std::string keyBuffer;
+  trace::forEachLine(body, [&](std::string_view line) {
+    counted.add(1, line.size() + 1);
+    uint32_t part = 0;
+    {
+      auto timed = hash.time(line.size() + 1);
+      part = static_cast<uint32_t>(
+          trace::hashKey(trace::keyField(line, format, keyBuffer)) % partitions);
+    }
+    auto timed = write.time(line.size() + 1);
+    outputs[part].appendLine(line);
+    rows[part]++;
+  });
+
+  uint64_t numLines = 0;
+  for (uint32_t i = 0; i < partitions; ++i) {
+    outputs[i].close();
+    numLines += rows[i];
+    std::cout << fmt::format("{}: {} lines", outputs[i].path(), rows[i])
+              << std::endl;
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = end - start;
+  std::cout << fmt::format("total processed lines: {} in {} partitions "
+                           "({:.2f} MB/s)",
+                           numLines, partitions,
+                           in.size() / 1e6 / elapsed.count())
+            << std::endl;
+  return 0;
+}
+
 int main(int argc, char **argv) {
+  trace::RunReport report("split_trace", argc, argv);
   argparse::ArgumentParser options("parser");
 
   options.add_argument("-i", "--input")
@@ -24,9 +273,24 @@ int main(int argc, char **argv) {
       .required()
       .help("Specify the output name");
   options.add_argument("-l", "--lines")
-      .required()
       .scan<'u', uint32_t>()
       .help("Specify the number of lines for each file except the header");
+  options.add_argument("-p", "--partitions")
+      .scan<'u', uint32_t>()
+      .help("Instead of --lines, route each row to one of N files by key "
+            "hash so every key stays in one file");
+  options.add_argument("-f", "--format")
+      .default_value(std::string("5col"))
+      .choices("5col", "7col")
+      .help("Input layout for --partitions and --byte-range");
+  options.add_argument("-b", "--byte-range")
+      .flag()
+      .help("Copy each part as a byte range without parsing rows; keeps the "
+            "input's header line (5col)");
+  options.add_argument("-t", "--threads")
+      .default_value(std::max(1u, std::thread::hardware_concurrency()))
+      .scan<'u', unsigned>()
+      .help("Threads for --byte-range");
 
   try {
     options.parse_args(argc, argv);
@@ -42,7 +306,33 @@ int main(int argc, char **argv) {
               << std::endl;
     std::exit(1);
   }
-  io::CSVReader<5> csvReader(traceFilePath);
+  trace::TraceFormat format = trace::TraceFormat::FiveColumn;
+  trace::parseTraceFormat(options.get<std::string>("--format"), format);
+  if (options.is_used("--partitions")) {
+    if (options.get<uint32_t>("--partitions") == 0) {
+      std::cerr << "--partitions must be positive" << std::endl;
+      std::exit(1);
+    }
+    return splitByKeyHash(traceFilePath, options.get<std::string>("--output"),
+                          options.get<uint32_t>("--partitions"), format);
+  }
+  if (!options.is_used("--lines") || options.get<uint32_t>("--lines") == 0) {
+    std::cerr << "--lines must be a positive number" << std::endl;
+    std::cerr << options;
+    std::exit(1);
+  }
+  if (options.get<bool>("--byte-range")) {
+    return splitByByteRange(traceFilePath, options.get<std::string>("--output"),
+                            options.get<uint32_t>("--lines"), format,
+                            std::max(1u, options.get<unsigned>("--threads")));
+  }
+  if (format != trace::TraceFormat::FiveColumn) {
+    std::cerr << "--lines without --byte-range reads 5col input only" << std::endl;
+    std::exit(1);
+  }
+  trace::ProgressReporter progress("split_trace", trace::fileBytes({traceFilePath}));
+  trace::ProgressReporter::Batch counted(progress);
+  io::CSVReader<5> csvReader(traceFilePath, trace::countedFile(traceFilePath, progress));
   csvReader.read_header(
       io::ignore_extra_column, "key", "op", "size", "op_count", "key_size");
 
@@ -53,20 +343,19 @@ int main(int argc, char **argv) {
   uint64_t numLines = 0;
   uint64_t targetNumLines = options.get<uint32_t>("--lines");
 
-  // To check throughput
-  auto start = std::chrono::high_resolution_clock::now();
-
   Row r;
-  while (csvReader.read_row(r.key, r.op, r.size, r.op_count, r.key_size)) {
+  trace::StageTimer parse(trace::Stage::Parse);
+  trace::StageTimer write(trace::Stage::Write);
+  while (true) {
+    {
+      auto timed = parse.timeCall();
+      if (!csvReader.read_row(r.key, r.op, r.size, r.op_count, r.key_size)) {
+        break;
+      }
+    }
+    parse.count(1, 0);
+    counted.add(1, 0);
     if (numLines % targetNumLines == 0) {
-      // Calculate throughput
-      auto end = std::chrono::high_resolution_clock::now();
-      std::chrono::duration<double> elapsed = end - start;
-      std::cout << fmt::format("Processing throughput: {:.2f} / sec (total {} "
-                               "lines are processed)",
-                               numLines / elapsed.count(), numLines)
-                << std::endl;
-
       output.close();
       auto outputFileName =
           fmt::format("./{}_{}.csv", outputPrefix, numLines / targetNumLines);
@@ -74,6 +363,7 @@ int main(int argc, char **argv) {
       // Write header for each split file
       output << "key,op,size,op_count,key_size" << "\n";
     }
+    auto timed = write.time();
     output << fmt::format("{},{},{},{},{}", 
         r.key, r.op, r.size, r.op_count, r.key_size) << "\n";
     numLines++;
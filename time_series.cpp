@@ -0,0 +1,275 @@
+#include "include/argparse/argparse.hpp"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "common/hyperloglog.h"
+#include "common/key_hash.h"
+#include "common/line_scan.h"
+#include "common/log_linear_histogram.h"
+#include "common/mapped_file.h"
+#include "common/progress.h"
+#include "common/run_report.h"
+#include "common/trace_format.h"
+#include "common/trace_record.h"
+
+enum OpClass { OP_GET, OP_GETS, OP_SET, OP_DELETE, OP_OTHER, NUM_OP_CLASSES };
+const char *const OP_NAMES[NUM_OP_CLASSES] = {"get", "gets", "set", "delete", "other"};
+
+OpClass opClass(std::string_view op) {
+  if (op == "get") return OP_GET;
+  if (op == "gets") return OP_GETS;
+  if (op == "set") return OP_SET;
+  if (op == "delete") return OP_DELETE;
+  return OP_OTHER;
+}
+
+// What the aggregation needs of one parsed row.
+struct Request {
+  uint64_t timestamp;
+  uint64_t clientHash;
+  uint32_t keySize;
+  uint32_t valueSize;
+  OpClass op;
+};
+
+// Totals of one output interval.
+struct IntervalStats {
+  uint64_t requests = 0;
+  uint64_t bytes = 0;
+  uint64_t ops[NUM_OP_CLASSES] = {};
+  uint64_t keyBytes = 0;
+  uint64_t valueBytes = 0;
+  trace::HyperLogLog clients;
+
+  void clear() {
+    requests = bytes = keyBytes = valueBytes = 0;
+    std::fill(ops, ops + NUM_OP_CLASSES, 0);
+    clients.clear();
+  }
+};
+
+// Folds requests in timestamp order into one row per interval and a
+// distribution of per-second rates. Memory does not grow with the trace:
+// one interval and one second are open at a time.
+class TimeSeries {
+ public:
+  TimeSeries(std::ostream &out, uint64_t interval) : out_(out), interval_(interval) {}
+
+  void add(const Request &r) {
+    // A row earlier than its predecessor counts at the predecessor's time.
+    uint64_t ts = r.timestamp;
+    if (!started_) {
+      started_ = true;
+      second_ = ts;
+      intervalStart_ = ts / interval_ * interval_;
+    } else if (ts < second_) {
+      lateRows_++;
+      ts = second_;
+    }
+    if (ts > second_) {
+      closeSecond();
+      // Seconds without requests are part of the rate distribution too.
+      requestRates_.record(0, ts - second_ - 1);
+      byteRates_.record(0, ts - second_ - 1);
+      second_ = ts;
+    }
+    while (ts >= intervalStart_ + interval_) {
+      emit();
+      intervalStart_ += interval_;
+    }
+    uint64_t bytes = uint64_t{r.keySize} + r.valueSize;
+    current_.requests++;
+    current_.bytes += bytes;
+    current_.ops[r.op]++;
+    current_.keyBytes += r.keySize;
+    current_.valueBytes += r.valueSize;
+    current_.clients.add(r.clientHash);
+    secondRequests_++;
+    secondBytes_ += bytes;
+  }
+
+  // Writes the open interval and the rate summary.
+  void finish() {
+    if (!started_) {
+      return;
+    }
+    closeSecond();
+    emit();
+    uint64_t seconds = requestRates_.total();
+    out_ << "# seconds " << seconds << "\n";
+    printRates("requests_per_second", requestRates_, totalRequests_, peakRequests_,
+               peakRequestsAt_);
+    printRates("bytes_per_second", byteRates_, totalBytes_, peakBytes_, peakBytesAt_);
+  }
+
+  uint64_t lateRows() const { return lateRows_; }
+
+ private:
+  void closeSecond() {
+    requestRates_.record(secondRequests_);
+    byteRates_.record(secondBytes_);
+    totalRequests_ += secondRequests_;
+    totalBytes_ += secondBytes_;
+    if (secondRequests_ > peakRequests_) {
+      peakRequests_ = secondRequests_;
+      peakRequestsAt_ = second_;
+    }
+    if (secondBytes_ > peakBytes_) {
+      peakBytes_ = secondBytes_;
+      peakBytesAt_ = second_;
+    }
+    secondRequests_ = 0;
+    secondBytes_ = 0;
+  }
+
+  void emit() {
+    const IntervalStats &s = current_;
+    out_ << intervalStart_ << " " << s.requests << " " << s.bytes;
+    for (uint64_t count : s.ops) {
+      out_ << " " << count;
+    }
+    out_ << " " << (s.requests ? static_cast<uint64_t>(s.clients.estimate() + 0.5) : 0) << " "
+         << (s.requests ? static_cast<double>(s.keyBytes) / s.requests : 0) << " "
+         << (s.requests ? static_cast<double>(s.valueBytes) / s.requests : 0) << "\n";
+    current_.clear();
+  }
+
+  // Quantiles are bin upper bounds, so they are capped at the exact peak.
+  void printRates(const char *name, const trace::LogLinearHistogram &rates, uint64_t total,
+                  uint64_t peak, uint64_t peakAt) {
+    uint64_t seconds = rates.total();
+    out_ << "# " << name << " mean " << (seconds ? static_cast<double>(total) / seconds : 0)
+         << " p50 " << std::min(rates.valueAtQuantile(0.5), peak) << " p99 "
+         << std::min(rates.valueAtQuantile(0.99), peak) << " peak " << peak << " at " << peakAt << "\n";
+  }
+
+  std::ostream &out_;
+  uint64_t interval_;
+  bool started_ = false;
+  uint64_t intervalStart_ = 0;
+  IntervalStats current_;
+  uint64_t second_ = 0;
+  uint64_t secondRequests_ = 0;
+  uint64_t secondBytes_ = 0;
+  // Per-second rates; 2^4 bins per power of two, so p99 is within 6%.
+  trace::LogLinearHistogram requestRates_{4};
+  trace::LogLinearHistogram byteRates_{4};
+  uint64_t totalRequests_ = 0;
+  uint64_t totalBytes_ = 0;
+  uint64_t peakRequests_ = 0;
+  uint64_t peakRequestsAt_ = 0;
+  uint64_t peakBytes_ = 0;
+  uint64_t peakBytesAt_ = 0;
+  uint64_t lateRows_ = 0;
+};
+
+int main(int argc, char *argv[]) {
+  trace::RunReport report("time_series", argc, argv);
+  argparse::ArgumentParser program("time_series", "1.0");
+
+  program.add_argument("input_files")
+      .help("One or more 7-column traces, read as one trace in the given order")
+      .required()
+      .remaining();
+  program.add_argument("-i", "--interval")
+      .default_value(std::string("1m"))
+      .help("Length of an output row, e.g. 60, 1m, 1h");
+  program.add_argument("-t", "--threads")
+      .default_value(std::max(1u, std::thread::hardware_concurrency()))
+      .scan<'u', unsigned>()
+      .help("Parsing threads; the output does not depend on this");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  std::vector<std::string> traceFiles;
+  try {
+    traceFiles = program.get<std::vector<std::string>>("input_files");
+    if (traceFiles.empty()) {
+      std::cerr << "No input files provided.\n";
+      return 1;
+    }
+  } catch (...) {
+    std::cerr << "No input files provided.\n";
+    return 1;
+  }
+
+  uint64_t interval = 0;
+  if (!trace::parseDuration(program.get<std::string>("--interval"), interval)) {
+    std::cerr << "Invalid --interval: " << program.get<std::string>("--interval") << "\n";
+    return 1;
+  }
+  unsigned threads = std::max(1u, program.get<unsigned>("--threads"));
+
+  std::cout << "# time requests bytes";
+  for (const char *op : OP_NAMES) {
+    std::cout << " " << op;
+  }
+  std::cout << " clients mean_key_size mean_value_size\n";
+
+  // The workers parse one window of the input into compact requests; this
+  // thread then folds them in input order, which is a small part of the
+  // parse cost.
+  TimeSeries series(std::cout, interval);
+  std::vector<std::vector<Request>> parts(threads);
+  std::vector<uint64_t> badLines(threads, 0);
+  trace::ProgressReporter progress("time_series", trace::fileBytes(traceFiles));
+  trace::StageTimer aggregate(trace::Stage::Aggregate);
+  for (const auto &filePath : traceFiles) {
+    trace::MappedFile in;
+    if (!in.open(filePath)) {
+      return 1;
+    }
+    trace::forEachWindow(
+        in.view(), threads, trace::WINDOW_BYTES,
+        [&](size_t t, std::string_view piece) {
+          std::vector<Request> &part = parts[t];
+          part.clear();
+          trace::TraceRecord rec;
+          trace::StageTimer parse(trace::Stage::Parse);
+          trace::ProgressReporter::Batch counted(progress);
+          trace::forEachLine(piece, [&](std::string_view line) {
+            counted.add(1, line.size() + 1);
+            auto timed = parse.time(line.size() + 1);
+            if (!trace::parseRecord(line, trace::TraceFormat::SevenColumn, rec)) {
+              badLines[t]++;
+              return;
+            }
+            part.push_back({rec.timestamp, trace::mixHash(rec.clientId), rec.keySize,
+                            rec.valueSize, opClass(rec.op)});
+          });
+        },
+        [&]() {
+          auto timed = aggregate.block();
+          for (const auto &part : parts) {
+            aggregate.count(part.size(), part.size() * sizeof(Request));
+            for (const Request &r : part) {
+              series.add(r);
+            }
+          }
+        });
+  }
+  series.finish();
+
+  if (series.lateRows() > 0) {
+    std::cerr << "Counted " << series.lateRows()
+              << " rows with an earlier timestamp than their predecessor at the "
+                 "predecessor's time.\n";
+  }
+  uint64_t bad = 0;
+  for (uint64_t b : badLines) {
+    bad += b;
+  }
+  if (bad > 0) {
+    std::cerr << "Skipped " << bad << " malformed lines.\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,245 @@
+#include "include/argparse/argparse.hpp"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "common/key_hash.h"
+#include "common/line_scan.h"
+#include "common/mapped_file.h"
+#include "common/progress.h"
+#include "common/run_report.h"
+#include "common/space_saving.h"
+#include "common/trace_format.h"
+#include "common/trace_record.h"
+
+// Heavy hitters by request count and by bytes (key + value size).
+struct TopKeys {
+  trace::SpaceSaving byRequests;
+  trace::SpaceSaving byBytes;
+
+  explicit TopKeys(size_t counters) : byRequests(counters), byBytes(counters) {}
+
+  void add(uint64_t keyHash, std::string_view key, uint32_t size) {
+    byRequests.add(keyHash, key, 1);
+    byBytes.add(keyHash, key, size);
+  }
+  void merge(const TopKeys &other) {
+    byRequests.merge(other.byRequests);
+    byBytes.merge(other.byBytes);
+  }
+  void clear() {
+    byRequests.clear();
+    byBytes.clear();
+  }
+};
+
+// Summary of the rows of one block that fall in one time window (the
+// whole block without --window).
+struct Segment {
+  uint64_t windowStart;
+  TopKeys top;
+};
+
+// One worker's segments of its current block. They are cleared and reused
+// block after block, so a worker holds only the windows one block touches.
+struct BlockSummary {
+  std::vector<Segment> segments;
+  size_t used = 0;
+
+  TopKeys &segment(uint64_t windowStart, size_t counters) {
+    if (used == 0 || windowStart > segments[used - 1].windowStart) {
+      if (used == segments.size()) {
+        segments.push_back({windowStart, TopKeys(counters)});
+      } else {
+        segments[used].windowStart = windowStart;
+      }
+      used++;
+    }
+    return segments[used - 1].top;
+  }
+  void clear() {
+    for (size_t i = 0; i < used; ++i) {
+      segments[i].top.clear();
+    }
+    used = 0;
+  }
+};
+
+// `lower` = count - error is a guaranteed lower bound of the key's weight.
+void printTop(std::ostream &out, const trace::SpaceSaving &summary, size_t n,
+              const std::string &title, const char *unit) {
+  out << "=== " << title << " ===\n";
+  out << "# total " << summary.total() << " max_error " << summary.maxError() << "\n";
+  out << "# rank key " << unit << " lower share\n";
+  size_t rank = 1;
+  for (const auto &counter : summary.top(n)) {
+    out << rank++ << " " << counter.key << " " << counter.count << " "
+        << counter.count - counter.error << " "
+        << (summary.total() ? static_cast<double>(counter.count) / summary.total() : 0) << "\n";
+  }
+  out << "\n";
+}
+
+void printTopKeys(std::ostream &out, const TopKeys &top, size_t n, const std::string &scope) {
+  printTop(out, top.byRequests, n, scope + " top keys by requests", "requests");
+  printTop(out, top.byBytes, n, scope + " top keys by bytes", "bytes");
+}
+
+int main(int argc, char *argv[]) {
+  trace::RunReport report("top_keys", argc, argv);
+  argparse::ArgumentParser program("top_keys", "1.0");
+
+  program.add_argument("input_files")
+      .help("One or more CSV trace files, read as one trace in the given order")
+      .required()
+      .remaining();
+  program.add_argument("-k", "--top")
+      .default_value(size_t{20})
+      .scan<'u', size_t>()
+      .help("Keys listed per ranking");
+  program.add_argument("-c", "--counters")
+      .default_value(size_t{10000})
+      .scan<'u', size_t>()
+      .help("Counters per ranking; the error is at most total / counters");
+  program.add_argument("-w", "--window")
+      .help("Also rank every window of this length, e.g. 1h (7col only)");
+  program.add_argument("-f", "--format")
+      .default_value(std::string("5col"))
+      .choices("5col", "7col")
+      .help("Input layout");
+  program.add_argument("-t", "--threads")
+      .default_value(std::max(1u, std::thread::hardware_concurrency()))
+      .scan<'u', unsigned>()
+      .help("Parsing threads; the output does not depend on this");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  std::vector<std::string> traceFiles;
+  try {
+    traceFiles = program.get<std::vector<std::string>>("input_files");
+    if (traceFiles.empty()) {
+      std::cerr << "No input files provided.\n";
+      return 1;
+    }
+  } catch (...) {
+    std::cerr << "No input files provided.\n";
+    return 1;
+  }
+
+  size_t topN = program.get<size_t>("--top");
+  size_t counters = std::max(program.get<size_t>("--counters"), topN);
+  unsigned threads = std::max(1u, program.get<unsigned>("--threads"));
+  trace::TraceFormat format = trace::TraceFormat::FiveColumn;
+  trace::parseTraceFormat(program.get<std::string>("--format"), format);
+  uint64_t window = 0;
+  if (program.is_used("--window")) {
+    if (format != trace::TraceFormat::SevenColumn) {
+      std::cerr << "--window needs the timestamps of --format 7col.\n";
+      return 1;
+    }
+    if (!trace::parseDuration(program.get<std::string>("--window"), window)) {
+      std::cerr << "Invalid --window: " << program.get<std::string>("--window") << "\n";
+      return 1;
+    }
+  }
+
+  TopKeys global(counters);
+  TopKeys windowTop(window ? counters : 1);
+  bool windowOpen = false;
+  uint64_t windowStart = 0;
+
+  // Every block of the input is summarized on its own, one block per
+  // thread and round, and the summaries are merged in input order, so the
+  // output does not depend on the number of threads. A row earlier than its
+  // block's open window counts in it.
+  const size_t BLOCK_BYTES = size_t{16} << 20;
+  std::vector<BlockSummary> blocks(threads);
+  std::vector<uint64_t> badLines(threads, 0);
+  trace::ProgressReporter progress("top_keys", trace::fileBytes(traceFiles));
+  trace::StageTimer aggregate(trace::Stage::Aggregate);
+  for (const auto &filePath : traceFiles) {
+    trace::MappedFile in;
+    if (!in.open(filePath)) {
+      return 1;
+    }
+    std::string_view body = in.view();
+    if (trace::hasHeader(format)) {
+      body = body.substr(trace::nextLineStart(body, 0));
+    }
+    size_t pos = 0;
+    while (pos < body.size()) {
+      std::vector<size_t> bounds = {pos};
+      while (bounds.size() <= threads && bounds.back() < body.size()) {
+        bounds.push_back(
+            trace::nextLineStart(body, std::min(body.size(), bounds.back() + BLOCK_BYTES)));
+      }
+      size_t numBlocks = bounds.size() - 1;
+      pos = bounds.back();
+      trace::parallelFor(numBlocks, [&](size_t b) {
+        BlockSummary &summary = blocks[b];
+        summary.clear();
+        trace::TraceRecord rec;
+        trace::StageTimer parse(trace::Stage::Parse);
+        trace::StageTimer count(trace::Stage::Aggregate);
+        trace::ProgressReporter::Batch counted(progress);
+        trace::forEachLine(
+            body.substr(bounds[b], bounds[b + 1] - bounds[b]), [&](std::string_view line) {
+              counted.add(1, line.size() + 1);
+              {
+                auto timed = parse.time(line.size() + 1);
+                if (!trace::parseRecord(line, format, rec)) {
+                  badLines[b]++;
+                  return;
+                }
+              }
+              auto timed = count.time();
+              uint64_t start = window ? rec.timestamp / window * window : 0;
+              summary.segment(start, counters).add(trace::hashKey(rec.key), rec.key,
+                                                   rec.objectSize);
+            });
+      });
+
+      auto timed = aggregate.block();
+      for (size_t b = 0; b < numBlocks; ++b) {
+        for (size_t i = 0; i < blocks[b].used; ++i) {
+          const Segment &segment = blocks[b].segments[i];
+          global.merge(segment.top);
+          if (window == 0) {
+            continue;
+          }
+          // Windows without requests are skipped.
+          if (!windowOpen) {
+            windowStart = segment.windowStart;
+            windowOpen = true;
+          } else if (segment.windowStart > windowStart) {
+            printTopKeys(std::cout, windowTop, topN, "Window " + std::to_string(windowStart));
+            windowTop.clear();
+            windowStart = segment.windowStart;
+          }
+          windowTop.merge(segment.top);
+        }
+      }
+    }
+  }
+  if (windowOpen) {
+    printTopKeys(std::cout, windowTop, topN, "Window " + std::to_string(windowStart));
+  }
+  printTopKeys(std::cout, global, topN, "All");
+
+  uint64_t bad = 0;
+  for (uint64_t b : badLines) {
+    bad += b;
+  }
+  if (bad > 0) {
+    std::cerr << "Skipped " << bad << " malformed lines.\n";
+  }
+
+  return 0;
+}
@@ -1,110 +1,20 @@
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <iomanip>
 #include <vector>
 
-#include "include/robin_hood/robin_hood.h"
 #include "include/csv/csv.h"
 #include "include/argparse/argparse.hpp"
-
-static const int TWO_KB = 2048;
-
-struct KeyAgg {
-    uint64_t sumObjectSize = 0;
-    uint64_t count = 0;
-};
-
-struct StatsAccumulator {
-    uint64_t totalKeySize = 0;
-    uint64_t totalValueSize = 0;
-    uint64_t totalObjectSize = 0;
-    uint64_t lineCount = 0;
-    
-    robin_hood::unordered_map<std::string, KeyAgg> mapKeyAgg;
-};
-
-struct Stats {
-    double avgKeySize = 0.0;
-    double avgValueSize = 0.0;
-    double avgObjectSize = 0.0;
-    uint64_t sumObjectSize = 0;
-    uint64_t sumKeyBasedAvg = 0;
-    uint64_t uniqueKeyCount = 0;
-    uint64_t totalKeyCount = 0;
-    uint64_t lineCount = 0;
-};
-
-// ----------------------------------------------------------------
-// Read oneline and update
-// ----------------------------------------------------------------
-inline void updateStats(StatsAccumulator &acc, 
-                        const std::string &key, 
-                        uint32_t keySize, 
-                        uint32_t valueSize, 
-                        uint32_t objectSize) 
-{
-    acc.totalKeySize    += keySize;
-    acc.totalValueSize  += valueSize;
-    acc.totalObjectSize += objectSize;
-    
-    if (acc.lineCount > 0 && acc.lineCount % 100000000 == 0) {
-        std::cout << "Processing " << acc.lineCount 
-                  << " lines, maybe more...\n";
-    }
-    acc.lineCount++;
-    
-    auto &agg = acc.mapKeyAgg[key];
-    agg.sumObjectSize += objectSize;
-    agg.count++;
-}
-
-// ----------------------------------------------------------------
-// StatsAccumulator => Stats
-// ----------------------------------------------------------------
-Stats computeStats(const StatsAccumulator &acc)
-{
-    Stats s;
-    if (acc.lineCount == 0) {
-        return s;
-    }
-    
-    s.avgKeySize    = static_cast<double>(acc.totalKeySize)    / acc.lineCount;
-    s.avgValueSize  = static_cast<double>(acc.totalValueSize)  / acc.lineCount;
-    s.avgObjectSize = static_cast<double>(acc.totalObjectSize) / acc.lineCount;
-    s.sumObjectSize = acc.totalObjectSize;
-    
-    uint64_t sumKeyAverages = 0;
-    for (const auto &kv : acc.mapKeyAgg) {
-        const auto &agg = kv.second;
-        if (agg.count > 0) {
-            sumKeyAverages += (agg.sumObjectSize / agg.count);
-        }
-    }
-    s.sumKeyBasedAvg = sumKeyAverages;
-    s.uniqueKeyCount = acc.mapKeyAgg.size();
-    s.totalKeyCount  = acc.lineCount;
-    s.lineCount      = acc.lineCount;
-    
-    return s;
-}
-
-// ----------------------------------------------------------------
-// Print stats
-// ----------------------------------------------------------------
-void printStats(std::ostream &out, const Stats &st, const std::string &title) {
-    out << "=== " << title << " ===\n";
-    out << "  Average key size     : " << std::fixed << std::setprecision(2) << st.avgKeySize << "\n";
-    out << "  Average value size   : " << std::fixed << std::setprecision(2) << st.avgValueSize << "\n";
-    out << "  Average object size  : " << std::fixed << std::setprecision(2) << st.avgObjectSize << "\n";
-    out << "  Footprint1 (sum of object size)               : " << st.sumObjectSize << "\n";
-    out << "  Footprint2 (sum of average of duplicated key) : " << st.sumKeyBasedAvg << "\n";
-    out << "  Unique key count     : " << st.uniqueKeyCount << "\n";
-    out << "  Total key count      : " << st.totalKeyCount  << "\n";
-    out << "  Total line count     : " << st.lineCount      << "\n\n";
-}
+#include "common/csv_source.h"
+#include "common/progress.h"
+#include "common/run_report.h"
+#include "common/trace_filter.h"
+#include "common/trace_format.h"
+#include "common/trace_stats.h"
 
 int main(int argc, char* argv[]) {
+    trace::RunReport report("trace_info", argc, argv);
     argparse::ArgumentParser program("csv_analyzer", "1.0");
     
     program.add_argument("-o", "--output")
@@ -115,6 +25,11 @@ int main(int argc, char* argv[]) {
         .help("One or more CSV trace files to analyze")
         .remaining();
     
+    program.add_argument("-f", "--format")
+        .default_value(std::string("5col"))
+        .choices("5col", "7col")
+        .help("Input layout; 7col adds TTL quantiles");
+    
     try {
         program.parse_args(argc, argv);
     } catch (const std::runtime_error &err) {
@@ -124,6 +39,8 @@ int main(int argc, char* argv[]) {
     }
 
     auto outputFilePath = program.get<std::string>("--output");
+    trace::TraceFormat format = trace::TraceFormat::FiveColumn;
+    trace::parseTraceFormat(program.get<std::string>("--format"), format);
     
     std::vector<std::string> traceFiles;
     try {
@@ -143,38 +60,94 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    StatsAccumulator accAll, accUnder2KB, accOver2KB;
+    trace::StatsAccumulator accAll, accUnder2KB, accOver2KB;
     
     uint32_t maxObjSize = 0;
+    trace::StageTimer parse(trace::Stage::Parse);
+    trace::StageTimer aggregate(trace::Stage::Aggregate);
+    trace::ProgressReporter progress("trace_info", trace::fileBytes(traceFiles));
+    trace::ProgressReporter::Batch counted(progress);
+    int mapAll = progress.addMap("All");
+    int mapUnder2KB = progress.addMap("Under 2KB");
+    int mapOver2KB = progress.addMap("Over 2KB");
+    auto addRow = [&](const std::string &key, uint32_t key_size, uint32_t valueSize,
+                      uint32_t objectSize) {
+        trace::updateStats(accAll,      key, key_size, valueSize, objectSize);
+        if (trace::isUnderTwoKB(objectSize)) {
+            trace::updateStats(accUnder2KB, key, key_size, valueSize, objectSize);
+        } else {
+            trace::updateStats(accOver2KB,  key, key_size, valueSize, objectSize);
+        }
+        maxObjSize = std::max(maxObjSize, objectSize);
+        if (accAll.lineCount % (1 << 18) == 0) {
+            progress.publishMap(mapAll, trace::mapHealth(accAll.mapKeyAgg));
+            progress.publishMap(mapUnder2KB, trace::mapHealth(accUnder2KB.mapKeyAgg));
+            progress.publishMap(mapOver2KB, trace::mapHealth(accOver2KB.mapKeyAgg));
+        }
+    };
+    
     for (const auto &filePath : traceFiles) {
-        io::CSVReader<5> csvIn(filePath);
+        std::error_code error;
+        parse.count(0, std::filesystem::file_size(filePath, error));
+        
+        if (format == trace::TraceFormat::SevenColumn) {
+            // timestamp,key,key_size,value_size,client_id,op,TTL without header
+            io::CSVReader<7> csvIn(filePath, trace::countedFile(filePath, progress));
+            
+            std::string key, op;
+            uint64_t timestamp = 0, client_id = 0, ttl = 0;
+            uint32_t key_size = 0, value_size = 0;
+            
+            while (true) {
+                {
+                    auto timed = parse.timeCall();
+                    if (!csvIn.read_row(timestamp, key, key_size, value_size, client_id, op, ttl)) {
+                        break;
+                    }
+                }
+                parse.count(1, 0);
+                counted.add(1, 0);
+                uint32_t objectSize = key_size + value_size;
+                
+                auto timed = aggregate.time();
+                trace::updateTtl(accAll, ttl);
+                trace::updateTtl(trace::isUnderTwoKB(objectSize) ? accUnder2KB : accOver2KB, ttl);
+                addRow(key, key_size, value_size, objectSize);
+            }
+            continue;
+        }
+        
+        io::CSVReader<5> csvIn(filePath, trace::countedFile(filePath, progress));
         csvIn.read_header(io::ignore_extra_column, 
                           "key", "op", "size", "op_count", "key_size");
         
         std::string key, op;
         uint32_t size = 0, op_count = 0, key_size = 0;
         
-        while (csvIn.read_row(key, op, size, op_count, key_size)) {
+        while (true) {
+            {
+                auto timed = parse.timeCall();
+                if (!csvIn.read_row(key, op, size, op_count, key_size)) {
+                    break;
+                }
+            }
+            parse.count(1, 0);
+            counted.add(1, 0);
             uint32_t objectSize = size;  
             uint32_t valueSize = objectSize - key_size;
             
-            updateStats(accAll,      key, key_size, valueSize, objectSize);
-            if (objectSize <= TWO_KB) {
-                updateStats(accUnder2KB, key, key_size, valueSize, objectSize);
-            } else {
-                updateStats(accOver2KB,  key, key_size, valueSize, objectSize);
-            }
-	    maxObjSize = std::max(maxObjSize, objectSize);
+            auto timed = aggregate.time();
+            addRow(key, key_size, valueSize, objectSize);
         }
     }
     
-    Stats statAll      = computeStats(accAll);
-    Stats statUnder2KB = computeStats(accUnder2KB);
-    Stats statOver2KB  = computeStats(accOver2KB);
+    trace::Stats statAll      = trace::computeStats(accAll);
+    trace::Stats statUnder2KB = trace::computeStats(accUnder2KB);
+    trace::Stats statOver2KB  = trace::computeStats(accOver2KB);
     
-    printStats(fout, statUnder2KB, "Under 2KB");
-    printStats(fout, statOver2KB,  "Over 2KB");
-    printStats(fout, statAll,      "All");
+    trace::printStats(fout, statUnder2KB, "Under 2KB");
+    trace::printStats(fout, statOver2KB,  "Over 2KB");
+    trace::printStats(fout, statAll,      "All");
     
     std::cout << "max obj size: " << maxObjSize << std::endl;
     fout.close();
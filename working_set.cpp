@@ -0,0 +1,259 @@
+#include "include/argparse/argparse.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "include/robin_hood/robin_hood.h"
+#include "common/key_hash.h"
+#include "common/line_scan.h"
+#include "common/mapped_file.h"
+#include "common/progress.h"
+#include "common/run_report.h"
+#include "common/trace_format.h"
+#include "common/trace_record.h"
+
+// Distinct keys and the bytes of their latest requests.
+struct KeysAndBytes {
+  uint64_t keys = 0;
+  uint64_t bytes = 0;
+};
+
+// Second of a key's latest request and its object size then.
+struct KeyState {
+  uint64_t lastSeen;
+  uint32_t size;
+};
+using KeyStates = robin_hood::unordered_flat_map<uint64_t, KeyState>;
+
+// Footprint and trailing-window working sets, exact to the second.
+//
+// Every key remembers the second of its latest request, and a ring of
+// per-second buckets holds how many keys (and bytes) were last requested in
+// each second. A window's working set is the keys whose latest request
+// falls inside it, kept as a running sum: a request moves its key into the
+// current second, and each tick drops the second that leaves the window.
+class WorkingSetTimeline {
+ public:
+  explicit WorkingSetTimeline(const std::vector<uint64_t> &windows)
+      : windows_(windows),
+        ring_(*std::max_element(windows.begin(), windows.end()) + 1),
+        sums_(windows.size()) {}
+
+  void start(uint64_t now) { now_ = now; }
+  uint64_t now() const { return now_; }
+
+  void access(uint64_t keyHash, uint32_t size) {
+    KeysAndBytes &current = ring_[now_ % ring_.size()];
+    current.keys++;
+    current.bytes += size;
+    auto inserted = keys_.try_emplace(keyHash, KeyState{now_, size});
+    total_.bytes += size;
+    if (inserted.second) {
+      total_.keys++;
+      for (auto &sum : sums_) {
+        sum.keys++;
+        sum.bytes += size;
+      }
+      return;
+    }
+    KeyState &key = inserted.first->second;
+    uint64_t age = now_ - key.lastSeen;
+    total_.bytes -= key.size;
+    if (age < ring_.size()) {
+      KeysAndBytes &previous = ring_[key.lastSeen % ring_.size()];
+      previous.keys--;
+      previous.bytes -= key.size;
+    }
+    for (size_t i = 0; i < windows_.size(); ++i) {
+      sums_[i].bytes += size;
+      if (age < windows_[i]) {
+        sums_[i].bytes -= key.size;
+      } else {
+        sums_[i].keys++;
+      }
+    }
+    key = {now_, size};
+  }
+
+  // Moves to the next second.
+  void tick() {
+    now_++;
+    for (size_t i = 0; i < windows_.size(); ++i) {
+      if (now_ >= windows_[i]) {
+        const KeysAndBytes &leaving = ring_[(now_ - windows_[i]) % ring_.size()];
+        sums_[i].keys -= leaving.keys;
+        sums_[i].bytes -= leaving.bytes;
+      }
+    }
+    // Held the second now_ - ring size, which every window has dropped.
+    ring_[now_ % ring_.size()] = KeysAndBytes();
+  }
+
+  const KeysAndBytes &total() const { return total_; }
+  const KeysAndBytes &window(size_t i) const { return sums_[i]; }
+  const KeyStates &keys() const { return keys_; }
+
+ private:
+  std::vector<uint64_t> windows_;
+  std::vector<KeysAndBytes> ring_;  // indexed by second % size
+  std::vector<KeysAndBytes> sums_;  // per window
+  KeysAndBytes total_;
+  KeyStates keys_;
+  uint64_t now_ = 0;
+};
+
+int main(int argc, char *argv[]) {
+  trace::RunReport report("working_set", argc, argv);
+  argparse::ArgumentParser program("working_set", "1.0");
+
+  program.add_argument("input_files")
+      .help("One or more 7-column traces, read as one trace in the given order")
+      .required()
+      .remaining();
+  program.add_argument("-i", "--interval")
+      .default_value(std::string("1m"))
+      .help("Time between output rows, e.g. 60, 1m, 1h");
+  program.add_argument("-w", "--windows")
+      .default_value(std::string("1m,1h,1d"))
+      .help("Comma separated trailing windows whose working sets are reported");
+  program.add_argument("-n", "--ratio")
+      .default_value(uint64_t{1})
+      .scan<'u', uint64_t>()
+      .help("Track only the keys hashed under 1/n and scale the counts by n");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  std::vector<std::string> traceFiles;
+  try {
+    traceFiles = program.get<std::vector<std::string>>("input_files");
+    if (traceFiles.empty()) {
+      std::cerr << "No input files provided.\n";
+      return 1;
+    }
+  } catch (...) {
+    std::cerr << "No input files provided.\n";
+    return 1;
+  }
+
+  uint64_t interval = 0;
+  if (!trace::parseDuration(program.get<std::string>("--interval"), interval)) {
+    std::cerr << "Invalid --interval: " << program.get<std::string>("--interval") << "\n";
+    return 1;
+  }
+  std::vector<std::string> windowNames;
+  std::vector<uint64_t> windows;
+  std::string_view windowList = program.get<std::string>("--windows");
+  while (!windowList.empty()) {
+    std::string name(trace::nextField(windowList));
+    uint64_t seconds = 0;
+    if (!trace::parseDuration(name, seconds) || seconds > 366 * 86400) {
+      std::cerr << "Invalid window (1s to 366d): " << name << "\n";
+      return 1;
+    }
+    windowNames.push_back(name);
+    windows.push_back(seconds);
+  }
+  if (windows.empty()) {
+    std::cerr << "No --windows given.\n";
+    return 1;
+  }
+  uint64_t n = program.get<uint64_t>("--ratio");
+  if (n == 0) {
+    std::cerr << "--ratio must be positive.\n";
+    return 1;
+  }
+  uint64_t limit = trace::hashLimitForRatio(n);
+  double scale = 1.0 / trace::hashLimitRate(limit);
+
+  std::ostream &out = std::cout;
+  out << "# time keys bytes";
+  for (const auto &name : windowNames) {
+    out << " " << name << "_keys " << name << "_bytes";
+  }
+  out << "\n";
+
+  WorkingSetTimeline timeline(windows);
+  auto estimate = [&](uint64_t value) {
+    return static_cast<uint64_t>(std::llround(static_cast<double>(value) * scale));
+  };
+  // One row per interval boundary, covering the requests before it.
+  auto emit = [&](uint64_t time) {
+    out << time << " " << estimate(timeline.total().keys) << " "
+        << estimate(timeline.total().bytes);
+    for (size_t i = 0; i < windows.size(); ++i) {
+      out << " " << estimate(timeline.window(i).keys) << " "
+          << estimate(timeline.window(i).bytes);
+    }
+    out << "\n";
+  };
+
+  trace::ProgressReporter progress("working_set", trace::fileBytes(traceFiles));
+  int keysMap = progress.addMap("keys");
+  trace::StageTimer parse(trace::Stage::Parse);
+  trace::StageTimer aggregate(trace::Stage::Aggregate);
+  trace::ProgressReporter::Batch counted(progress);
+  trace::TraceRecord rec;
+  bool started = false;
+  uint64_t rows = 0;
+  uint64_t badLines = 0;
+  uint64_t lateRows = 0;
+  for (const auto &filePath : traceFiles) {
+    trace::MappedFile in;
+    if (!in.open(filePath)) {
+      return 1;
+    }
+    trace::forEachLine(in.view(), [&](std::string_view line) {
+      counted.add(1, line.size() + 1);
+      {
+        auto timed = parse.time(line.size() + 1);
+        if (!trace::parseRecord(line, trace::TraceFormat::SevenColumn, rec)) {
+          badLines++;
+          return;
+        }
+      }
+      auto timed = aggregate.time();
+      if (!started) {
+        timeline.start(rec.timestamp);
+        started = true;
+      }
+      if (rec.timestamp < timeline.now()) {
+        lateRows++;
+      }
+      while (timeline.now() < rec.timestamp) {
+        if ((timeline.now() + 1) % interval == 0) {
+          emit(timeline.now() + 1);
+        }
+        timeline.tick();
+      }
+      uint64_t h = trace::hashKey(rec.key);
+      if (h <= limit) {
+        timeline.access(h, rec.objectSize);
+      }
+      if ((++rows & ((1u << 18) - 1)) == 0) {
+        progress.publishMap(keysMap, trace::mapHealth(timeline.keys()));
+      }
+    });
+  }
+  if (started) {
+    emit(timeline.now() + 1);
+  }
+
+  if (lateRows > 0) {
+    std::cerr << "Counted " << lateRows
+              << " rows with an earlier timestamp than their predecessor at the "
+                 "predecessor's time.\n";
+  }
+  if (badLines > 0) {
+    std::cerr << "Skipped " << badLines << " malformed lines.\n";
+  }
+
+  return 0;
+}